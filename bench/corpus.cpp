@@ -0,0 +1,174 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#define NSPRE_IMPL
+#include "nspre.hpp"
+static_assert(NSPRE_VERSION_MAJOR == 1);
+
+#include "corpus.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+namespace bench {
+
+// splitmix64
+uint64_t Rng::next() {
+	uint64_t z = (m_state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+double Samples::mean() const {
+	if (values.empty()) {
+		return 0.0;
+	}
+
+	return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+double Samples::percentile(double p) const {
+	if (values.empty()) {
+		return 0.0;
+	}
+
+	std::vector<double> sorted = values;
+	std::sort(sorted.begin(), sorted.end());
+	size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+	return sorted[i];
+}
+
+fs::path temp_dir(const std::string& tag) {
+	fs::path dir = fs::temp_directory_path() / ("nspre-bench-" + std::to_string(getpid())) / tag;
+	fs::create_directories(dir);
+	return dir;
+}
+
+void fill_data(std::vector<char>& buf, DataKind kind, Rng& rng) {
+	static const char* words[] = {"level", "texture", "skater", "rail", "grind", "park", "sound", "model", "\n", " "};
+
+	if (kind == DATA_RANDOM) {
+		for (size_t i = 0; i < buf.size(); i += 8) {
+			uint64_t v = rng.next();
+			std::memcpy(buf.data() + i, &v, std::min<size_t>(8, buf.size() - i));
+		}
+	}
+	else if (kind == DATA_REPETITIVE) {
+		// Long runs of a handful of byte values
+		size_t i = 0;
+		while (i < buf.size()) {
+			uint64_t v = rng.next();
+			size_t run = 64 + (v & 1023);
+			char c = (char)((v >> 16) & 3);
+			for (size_t j = 0; j < run && i < buf.size(); ++j, ++i) {
+				buf[i] = c;
+			}
+		}
+	}
+	else {
+		size_t i = 0;
+		while (i < buf.size()) {
+			const char* w = words[rng.next() % 10];
+			for (; *w && i < buf.size(); ++w, ++i) {
+				buf[i] = *w;
+			}
+		}
+	}
+}
+
+bool write_data(const fs::path& path, uint64_t size, DataKind kind, uint64_t seed) {
+	std::FILE* f = std::fopen(path.c_str(), "wb");
+	if (!f) {
+		return false;
+	}
+
+	Rng rng(seed);
+	std::vector<char> buf;
+	uint64_t left = size;
+	while (left) {
+		buf.resize(std::min<uint64_t>(left, 1 << 20));
+		fill_data(buf, kind, rng);
+		if (std::fwrite(buf.data(), 1, buf.size(), f) != buf.size()) {
+			std::fclose(f);
+			return false;
+		}
+		left -= buf.size();
+	}
+
+	return std::fclose(f) == 0;
+}
+
+// Subfiles are drawn from a small pool of source files so archives with
+// 100k entries don't need 100k inputs on disk
+int make_archive(const fs::path& out, const fs::path& src_dir, int entries, uint64_t entry_size, DataKind kind, uint64_t seed) {
+	const int pool_size = std::min(entries, 64);
+	std::vector<fs::path> pool;
+	for (int i = 0; i < pool_size; ++i) {
+		fs::path p = src_dir / ("src" + std::to_string(i) + ".bin");
+		if (!write_data(p, entry_size, kind, seed + i)) {
+			return nspre::Error::FILE_OPEN_OUTPUT;
+		}
+		pool.push_back(p);
+	}
+
+	std::vector<nspre::Subfile> subfiles;
+	subfiles.reserve(entries);
+	for (int i = 0; i < entries; ++i) {
+		char prepath[96];
+		std::snprintf(prepath, sizeof(prepath), "\\levels\\bench\\dir%03d\\file%06d.bin", i / 1000, i);
+		subfiles.push_back({pool[i % pool_size], prepath});
+	}
+
+	return nspre::write(subfiles, out);
+}
+
+bool make_directory(const fs::path& dir, int files) {
+	fs::create_directories(dir);
+	for (int i = 0; i < files; ++i) {
+		char name[64];
+		// Mix of extensions so the pre/prx filter has something to do
+		std::snprintf(name, sizeof(name), "file%06d.%s", i, (i % 4) ? "bin" : "pre");
+		std::FILE* f = std::fopen((dir / name).c_str(), "wb");
+		if (!f) {
+			return false;
+		}
+		std::fclose(f);
+	}
+
+	return true;
+}
+
+uint64_t now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double seconds_since(uint64_t start_ns) {
+	return (now_ns() - start_ns) / 1e9;
+}
+
+}
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace ns {
+namespace bench {
+
+enum DataKind {
+	DATA_RANDOM,
+	DATA_REPETITIVE,
+	DATA_TEXT
+};
+
+// Deterministic so corpora are the same between runs and machines
+class Rng {
+	uint64_t m_state;
+public:
+	Rng(uint64_t seed) : m_state(seed) {}
+	uint64_t next();
+};
+
+struct Samples {
+	std::vector<double> values;
+
+	void add(double v) { values.push_back(v); }
+	double mean() const;
+	double percentile(double p) const;
+};
+
+std::filesystem::path temp_dir(const std::string& tag);
+void fill_data(std::vector<char>& buf, DataKind kind, Rng& rng);
+bool write_data(const std::filesystem::path& path, uint64_t size, DataKind kind, uint64_t seed);
+int make_archive(const std::filesystem::path& out, const std::filesystem::path& src_dir, int entries, uint64_t entry_size, DataKind kind, uint64_t seed);
+bool make_directory(const std::filesystem::path& dir, int files);
+uint64_t now_ns();
+double seconds_since(uint64_t start_ns);
+
+}
+}
@@ -0,0 +1,274 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Archive operation benchmark. Generates reproducible corpora and measures
+// opening, extracting, creating and manifest export in MB/s and entries/s.
+
+#include "nspre-gui.hpp"
+#include "corpus.hpp"
+#include <algorithm>
+#include <ctime>
+#include <thread>
+
+#ifndef NSPRE_GUI_VERSION
+#define NSPRE_GUI_VERSION "undefined"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+using namespace bench;
+
+struct Corpus {
+	const char* name;
+	int entries;
+	uint64_t entry_size;
+	DataKind kind;
+};
+
+struct OpResult {
+	std::string corpus;
+	std::string op;
+	uint64_t bytes;
+	uint64_t entries;
+	Samples seconds;
+};
+
+class NspreBench {
+	std::vector<OpResult> m_results;
+	int m_runs;
+
+	template<class F> void measure(const Corpus& c, const char* op, uint64_t bytes, uint64_t entries, F&& fn) {
+		OpResult r;
+		r.corpus = c.name;
+		r.op = op;
+		r.bytes = bytes;
+		r.entries = entries;
+
+		for (int i = 0; i < m_runs; ++i) {
+			uint64_t start = now_ns();
+			if (!fn()) {
+				std::fprintf(stderr, "%s/%s failed\n", c.name, op);
+				return;
+			}
+			r.seconds.add(seconds_since(start));
+		}
+
+		double best = r.seconds.percentile(0.0);
+		std::printf("%-14s %-20s %10.1f %12.0f %10.3f\n", c.name, op, bytes / best / 1e6, entries / best, r.seconds.percentile(0.5));
+		std::fflush(stdout);
+		m_results.push_back(std::move(r));
+	}
+public:
+	NspreBench(int runs) : m_runs(runs) {}
+
+	void run(const Corpus& c) {
+		fs::path root = temp_dir(c.name);
+		fs::path src = root / "src";
+		fs::path out = root / "out";
+		fs::create_directories(src);
+		fs::create_directories(out);
+
+		// Every entry gets its own input so creation reads as much as it writes
+		std::vector<nspre::Subfile> subfiles;
+		for (int i = 0; i < c.entries; ++i) {
+			fs::path p = src / ("in" + std::to_string(i) + ".bin");
+			if (!write_data(p, c.entry_size, c.kind, i)) {
+				std::fprintf(stderr, "can't create \"%s\"\n", p.c_str());
+				return;
+			}
+
+			char prepath[96];
+			std::snprintf(prepath, sizeof(prepath), "\\levels\\bench\\%s\\file%06d.bin", c.name, i);
+			subfiles.push_back({p, prepath});
+		}
+
+		uint64_t raw_bytes = (uint64_t)c.entries * c.entry_size;
+		fs::path archive = root / "bench.pre";
+
+		measure(c, "create", raw_bytes, c.entries, [&]() {
+			return nspre::write(subfiles, archive) == 0;
+		});
+
+		uint64_t archive_bytes = fs::file_size(archive);
+
+		measure(c, "open", archive_bytes, c.entries, [&]() {
+			nspre::Reader reader;
+			return reader.open(archive) == 0;
+		});
+
+		nspre::Reader reader;
+		if (reader.open(archive)) {
+			std::fprintf(stderr, "can't open \"%s\"\n", archive.c_str());
+			return;
+		}
+
+		measure(c, "extract", raw_bytes, c.entries, [&]() {
+			for (auto& f : reader.files()) {
+				if (f.extract(out / f.filename())) {
+					return false;
+				}
+			}
+			return true;
+		});
+
+		// Stored entries copied from the archive file instead of through nspre
+		measure(c, "extract_direct", raw_bytes, c.entries, [&]() {
+			Extractor extractor(reader, archive);
+			auto& files = reader.files();
+			for (size_t i = 0; i < files.size(); ++i) {
+				if (extractor.extract(i, out / files[i].filename())) {
+					return false;
+				}
+			}
+			return true;
+		});
+
+		// Skipped on kernels without io_uring
+		UringWriter probe;
+		if (probe.init(NSPRE_GUI_URING_DEPTH)) {
+			measure(c, "extract_uring", raw_bytes, c.entries, [&]() {
+				Extractor extractor(reader, archive);
+				if (!extractor.use_uring(NSPRE_GUI_URING_DEPTH)) {
+					return false;
+				}
+
+				auto& files = reader.files();
+				for (size_t i = 0; i < files.size(); ++i) {
+					if (extractor.extract(i, out / files[i].filename())) {
+						return false;
+					}
+				}
+				return extractor.finish() == 0;
+			});
+		}
+
+		static const char* manifest_ops[] = {"csv", "jsonl", "binary"};
+		for (int format = MANIFEST_CSV; format <= MANIFEST_BINARY; ++format) {
+			for (unsigned columns : {0u, (unsigned)(MANIFEST_OFFSET | MANIFEST_RATIO | MANIFEST_HASH)}) {
+				ManifestOptions options;
+				options.format = format;
+				options.columns = columns;
+
+				fs::path manifest = root / (std::string("manifest") + manifest_extension(format));
+				if (write_manifest(reader, archive, manifest, options)) {
+					std::fprintf(stderr, "can't write \"%s\"\n", manifest.c_str());
+					continue;
+				}
+
+				std::string op = std::string("manifest_") + manifest_ops[format] + (columns ? "_all" : "");
+				measure(c, op.c_str(), fs::file_size(manifest), c.entries, [&]() {
+					return write_manifest(reader, archive, manifest, options) == 0;
+				});
+			}
+		}
+
+		reader.close();
+		std::error_code ec;
+		fs::remove_all(root, ec);
+	}
+
+	bool write_json(std::FILE* f) {
+		std::fprintf(f, "{\n  \"version\": \"%s\",\n  \"timestamp\": %lld,\n  \"threads\": %u,\n  \"runs\": %d,\n  \"results\": [\n",
+			NSPRE_GUI_VERSION,
+			(long long)std::time(0),
+			std::thread::hardware_concurrency(),
+			m_runs
+		);
+
+		for (size_t i = 0; i < m_results.size(); ++i) {
+			auto& r = m_results[i];
+			double best = r.seconds.percentile(0.0);
+			std::fprintf(f, "    {\"corpus\":\"%s\",\"op\":\"%s\",\"bytes\":%llu,\"entries\":%llu,"
+				"\"seconds_best\":%.6f,\"seconds_median\":%.6f,\"mb_per_s\":%.2f,\"entries_per_s\":%.1f}%s\n",
+				r.corpus.c_str(),
+				r.op.c_str(),
+				(unsigned long long)r.bytes,
+				(unsigned long long)r.entries,
+				best,
+				r.seconds.percentile(0.5),
+				r.bytes / best / 1e6,
+				r.entries / best,
+				i + 1 < m_results.size() ? "," : ""
+			);
+		}
+
+		std::fprintf(f, "  ]\n}\n");
+		return !std::ferror(f);
+	}
+};
+
+}
+
+int main(int argc, char** argv) {
+	int runs = 3;
+	int scale = 1;
+	const char* json_out = 0;
+	const char* only = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		bool has_val = (i + 1 < argc);
+		if (has_val && std::strcmp("--runs", argv[i]) == 0) {
+			runs = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (has_val && std::strcmp("--scale", argv[i]) == 0) {
+			scale = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (has_val && std::strcmp("--json", argv[i]) == 0) {
+			json_out = argv[++i];
+		}
+		else if (has_val && std::strcmp("--corpus", argv[i]) == 0) {
+			only = argv[++i];
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--runs N] [--scale N] [--corpus NAME] [--json out.json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const ns::Corpus corpora[] = {
+		{"tiny",           20000 * scale, 256,                ns::bench::DATA_TEXT},
+		{"huge",           4,             (32 << 20) * (uint64_t)scale, ns::bench::DATA_TEXT},
+		{"incompressible", 64 * scale,    1 << 20,            ns::bench::DATA_RANDOM},
+		{"repetitive",     64 * scale,    1 << 20,            ns::bench::DATA_REPETITIVE},
+	};
+
+	ns::NspreBench bench(runs);
+	std::printf("%-14s %-20s %10s %12s %10s\n", "corpus", "op", "MB/s", "entries/s", "median_s");
+	for (auto& c : corpora) {
+		if (!only || std::strcmp(only, c.name) == 0) {
+			bench.run(c);
+		}
+	}
+
+	if (json_out) {
+		std::FILE* f = std::strcmp(json_out, "-") ? std::fopen(json_out, "w") : stdout;
+		if (!f || !bench.write_json(f)) {
+			std::fprintf(stderr, "can't write \"%s\"\n", json_out);
+			return 1;
+		}
+		if (f != stdout) {
+			std::fclose(f);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,359 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Headless UI benchmark. Draws the extract, create and file browser views
+// with an ImGui context that has no platform or renderer backend and
+// reports per-frame CPU time and allocation counts for scripted input.
+
+#include "nspre-gui.hpp"
+#include "corpus.hpp"
+#include "imgui.h"
+#include <atomic>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <new>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static std::atomic<uint64_t> alloc_count(0);
+
+void* operator new(size_t size) {
+	++alloc_count;
+	void* p = std::malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+static void* imgui_alloc(size_t size, void*) {
+	++alloc_count;
+	return std::malloc(size);
+}
+
+static void imgui_free(void* p, void*) {
+	std::free(p);
+}
+
+namespace ns {
+
+using namespace bench;
+
+GlobalStruct global;
+ExtractWindow extract_window;
+CreateWindow create_window;
+DiffWindow diff_window;
+
+void request_redraw() {}
+
+enum Interaction {
+	INTERACT_IDLE,
+	INTERACT_SCROLL,
+	INTERACT_SORT,
+	INTERACT_FILTER
+};
+
+static const char* interaction_names[] = {"idle", "scroll", "sort", "filter"};
+
+struct BenchResult {
+	std::string target;
+	int entries;
+	int interaction;
+	Samples cpu_us;
+	Samples allocs;
+};
+
+static uint64_t thread_cpu_ns() {
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct UiBench {
+	int frames = 120;
+	std::vector<BenchResult> results;
+
+	template<class B> static void sort(B& b, int column, bool ascending) {
+		b.m_sort_column = column;
+		b.m_sort_ascending = ascending;
+		b.sort_entries();
+	}
+
+	template<class B> static void toggle_hidden(B& b) {
+		b.m_show_hidden = !b.m_show_hidden;
+	}
+
+	static void toggle_filter(FileBrowserOpenOne& b) {
+		b.filter = !b.filter;
+	}
+
+	// Same window setup as top_window() in main.cpp
+	static void frame(const std::function<void()>& draw) {
+		ImGuiIO& io = ImGui::GetIO();
+		io.DeltaTime = 1.0f / 60.0f;
+		ImGui::NewFrame();
+		ImGui::SetNextWindowSize(io.DisplaySize);
+		ImGui::SetNextWindowPos({0,0});
+		ImGui::Begin("bench", 0, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoBringToFrontOnFocus);
+		draw();
+		ImGui::End();
+		ImGui::Render();
+	}
+
+	static void interact(int interaction, int frame) {
+		ImGuiIO& io = ImGui::GetIO();
+		io.AddMousePosEvent(io.DisplaySize.x / 2, io.DisplaySize.y / 2);
+		if (interaction == INTERACT_SCROLL) {
+			// Down for a second, then back up
+			io.AddMouseWheelEvent(0.0f, (frame / 60) % 2 ? 5.0f : -5.0f);
+		}
+	}
+
+	void run(const std::string& target, int entries, int interaction, const std::function<void()>& draw, const std::function<void(int)>& act) {
+		BenchResult r;
+		r.target = target;
+		r.entries = entries;
+		r.interaction = interaction;
+
+		for (int i = 0; i < frames; ++i) {
+			interact(interaction, i);
+
+			uint64_t allocs = alloc_count;
+			uint64_t start = thread_cpu_ns();
+			if (act) {
+				act(i);
+			}
+			frame(draw);
+			r.cpu_us.add((thread_cpu_ns() - start) / 1000.0);
+			r.allocs.add((double)(alloc_count - allocs));
+		}
+
+		std::printf("%-18s %7d %-7s %10.1f %10.1f %10.1f %10.1f\n",
+			target.c_str(),
+			entries,
+			interaction_names[interaction],
+			r.cpu_us.mean(),
+			r.cpu_us.percentile(0.5),
+			r.cpu_us.percentile(0.99),
+			r.allocs.mean()
+		);
+		std::fflush(stdout);
+		results.push_back(std::move(r));
+	}
+
+	// Background workers (stat, header sniffing, archive loading) finish
+	// while frames keep getting drawn, like they would in the app
+	static void warm_up(const std::function<void()>& draw) {
+		for (int i = 0; i < 100; ++i) {
+			frame(draw);
+			usleep(10000);
+		}
+	}
+
+	template<class B> void run_browser(const std::string& target, int entries, B& b, const std::function<void()>& draw) {
+		warm_up(draw);
+		run(target, entries, INTERACT_IDLE, draw, 0);
+		run(target, entries, INTERACT_SCROLL, draw, 0);
+		run(target, entries, INTERACT_SORT, draw, [&b](int i) { sort(b, i % 3, (i / 3) % 2 == 0); });
+		run(target, entries, INTERACT_FILTER, draw, [&b](int i) { toggle_hidden(b); });
+	}
+
+	void run_size(int entries) {
+		fs::path root = temp_dir("ui" + std::to_string(entries));
+		fs::path archive = root / "bench.pre";
+		fs::path dir = root / "dir";
+
+		if (make_archive(archive, root, entries, 256, DATA_TEXT, entries)) {
+			std::fprintf(stderr, "can't create archive \"%s\"\n", archive.c_str());
+			return;
+		}
+
+		if (!make_directory(dir, entries)) {
+			std::fprintf(stderr, "can't create directory \"%s\"\n", dir.c_str());
+			return;
+		}
+
+		{
+			ExtractWindow ew;
+			ew.open_pre(archive);
+			auto draw = [&ew]() { ew.show(); };
+			warm_up(draw);
+
+			// Opening happens in the background, wait for it
+			uint64_t start = now_ns();
+			while (!ew.pre_is_open() && seconds_since(start) < 120.0) {
+				frame(draw);
+				usleep(10000);
+			}
+			run("extract", entries, INTERACT_IDLE, draw, 0);
+			run("extract", entries, INTERACT_SCROLL, draw, 0);
+		}
+
+		{
+			CreateWindow cw;
+			PathList paths;
+			for (auto& e : fs::directory_iterator(dir)) {
+				paths.push_back(e.path());
+			}
+			cw.drop_files(paths);
+			auto draw = [&cw]() { cw.show(); };
+			warm_up(draw);
+
+			// Dropped paths are scanned in the background, wait for them
+			uint64_t start = now_ns();
+			while (cw.scan_progress.scanning && seconds_since(start) < 120.0) {
+				frame(draw);
+				usleep(10000);
+			}
+			run("create", entries, INTERACT_IDLE, draw, 0);
+			run("create", entries, INTERACT_SCROLL, draw, 0);
+		}
+
+		fs::path old_cwd = fs::current_path();
+		fs::current_path(dir);
+
+		{
+			FileBrowserOpenOne b;
+			auto draw = [&b]() { b.show(); };
+			warm_up(draw);
+			run_browser("browser_open_one", entries, b, draw);
+			run("browser_open_one_ext", entries, INTERACT_FILTER, draw, [&b](int i) { toggle_filter(b); });
+		}
+
+		{
+			FileBrowserOpenMulti b;
+			auto draw = [&b]() { b.show(); };
+			run_browser("browser_open_multi", entries, b, draw);
+		}
+
+		{
+			FileBrowserSaveMulti b;
+			auto draw = [&b]() { b.show(); };
+			run_browser("browser_save_multi", entries, b, draw);
+		}
+
+		{
+			fs::path out;
+			bool do_save = false;
+			FileBrowserSaveOne b(out, do_save);
+			auto draw = [&b]() { b.show("out.pre"); };
+			run_browser("browser_save_one", entries, b, draw);
+		}
+
+		fs::current_path(old_cwd);
+		std::error_code ec;
+		fs::remove_all(root, ec);
+	}
+
+	bool write_json(const fs::path& path) {
+		std::FILE* f = std::fopen(path.c_str(), "w");
+		if (!f) {
+			return false;
+		}
+
+		std::fprintf(f, "[\n");
+		for (size_t i = 0; i < results.size(); ++i) {
+			auto& r = results[i];
+			std::fprintf(f, "  {\"target\":\"%s\",\"entries\":%d,\"interaction\":\"%s\",\"frames\":%zu,"
+				"\"cpu_us_mean\":%.2f,\"cpu_us_p50\":%.2f,\"cpu_us_p99\":%.2f,\"allocs_mean\":%.2f,\"allocs_max\":%.0f}%s\n",
+				r.target.c_str(),
+				r.entries,
+				interaction_names[r.interaction],
+				r.cpu_us.values.size(),
+				r.cpu_us.mean(),
+				r.cpu_us.percentile(0.5),
+				r.cpu_us.percentile(0.99),
+				r.allocs.mean(),
+				r.allocs.percentile(1.0),
+				i + 1 < results.size() ? "," : ""
+			);
+		}
+		std::fprintf(f, "]\n");
+		return std::fclose(f) == 0;
+	}
+};
+
+}
+
+int main(int argc, char** argv) {
+	ns::UiBench bench;
+	std::vector<int> sizes = {1000, 10000, 100000};
+	const char* json_out = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		bool has_val = (i + 1 < argc);
+		if (has_val && std::strcmp("--frames", argv[i]) == 0) {
+			bench.frames = std::atoi(argv[++i]);
+		}
+		else if (has_val && std::strcmp("--sizes", argv[i]) == 0) {
+			sizes.clear();
+			std::stringstream ss(argv[++i]);
+			std::string item;
+			while (std::getline(ss, item, ',')) {
+				sizes.push_back(std::atoi(item.c_str()));
+			}
+		}
+		else if (has_val && std::strcmp("--json", argv[i]) == 0) {
+			json_out = argv[++i];
+		}
+		else {
+			std::fprintf(stderr, "usage: %s [--frames N] [--sizes N,N,...] [--json out.json]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	ImGui::SetAllocatorFunctions(imgui_alloc, imgui_free);
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	ns::global.io = &io;
+	io.IniFilename = 0;
+	io.DisplaySize = {1200, 800};
+
+	// No renderer backend, so build the font atlas here
+	unsigned char* pixels;
+	int width;
+	int height;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+	std::printf("%-18s %7s %-7s %10s %10s %10s %10s\n", "target", "entries", "action", "mean_us", "p50_us", "p99_us", "allocs");
+	for (int size : sizes) {
+		bench.run_size(size);
+	}
+
+	ImGui::DestroyContext();
+
+	if (json_out && !bench.write_json(json_out)) {
+		std::fprintf(stderr, "can't write \"%s\"\n", json_out);
+		return 1;
+	}
+
+	return 0;
+}
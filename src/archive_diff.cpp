@@ -0,0 +1,259 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unordered_map>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+static const size_t DIFF_READ_SIZE = 1 << 20;
+
+namespace {
+
+// Per thread state for the comparison jobs. Readers and the scratch
+// directory are only set up once an entry has to be decompressed.
+struct DiffWorker {
+	const ArchiveDiff& diff;
+	std::vector<char> buf_a;
+	std::vector<char> buf_b;
+	nspre::Reader old_reader;
+	nspre::Reader new_reader;
+	fs::path scratch;
+	bool readers_open = false;
+	bool readers_ok = false;
+
+	DiffWorker(const ArchiveDiff& d) : diff(d), buf_a(BufferPool::take(DIFF_READ_SIZE)), buf_b(BufferPool::take(DIFF_READ_SIZE)) {}
+
+	~DiffWorker() {
+		BufferPool::give(std::move(buf_a));
+		BufferPool::give(std::move(buf_b));
+		std::error_code ec;
+		if (!scratch.empty()) {
+			fs::remove_all(scratch, ec);
+		}
+	}
+
+	bool same_bytes(int fd_a, const PreLayoutEntry& a, int fd_b, const PreLayoutEntry& b) {
+		uint64_t off_a = a.data_offset;
+		uint64_t off_b = b.data_offset;
+		uint64_t left = a.data_size();
+		while (left) {
+			size_t want = left < DIFF_READ_SIZE ? left : DIFF_READ_SIZE;
+			if (pread(fd_a, buf_a.data(), want, off_a) != (ssize_t)want ||
+				pread(fd_b, buf_b.data(), want, off_b) != (ssize_t)want ||
+				std::memcmp(buf_a.data(), buf_b.data(), want)
+			) {
+				return false;
+			}
+			off_a += want;
+			off_b += want;
+			left -= want;
+		}
+
+		return true;
+	}
+
+	bool open_readers() {
+		if (!readers_open) {
+			readers_open = true;
+			static std::atomic<unsigned> counter{0};
+			std::error_code ec;
+			scratch = fs::temp_directory_path(ec) / ("nspre-gui-diff-" + std::to_string(getpid()) + "-" + std::to_string(counter++));
+			readers_ok = fs::create_directories(scratch, ec) &&
+				old_reader.open(diff.old_path) == 0 &&
+				new_reader.open(diff.new_path) == 0;
+		}
+
+		return readers_ok;
+	}
+
+	// nspre only extracts to files, so contents are hashed from a scratch copy
+	bool content_hash(nspre::Reader& reader, uint32_t index, const std::string& prepath, uint64_t& hash) {
+		auto& files = reader.files();
+		if (index >= files.size() || files[index].prepath() != prepath) {
+			return false;
+		}
+
+		fs::path tmp = scratch / "entry";
+		if (files[index].extract(tmp)) {
+			return false;
+		}
+
+		int fd = open(tmp.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			return false;
+		}
+
+		PreLayoutEntry whole;
+		std::error_code ec;
+		whole.size = fs::file_size(tmp, ec);
+		bool ok = !ec && hash_entry(fd, whole, buf_a, hash);
+		close(fd);
+		fs::remove(tmp, ec);
+		return ok;
+	}
+};
+
+struct DiffPair {
+	uint32_t entry;
+	uint32_t old_index;
+	uint32_t new_index;
+};
+
+}
+
+// Entries are matched by internal path. Size changes are enough to call an
+// entry modified, otherwise the stored bytes are compared and only entries
+// whose stored bytes differ while one side is compressed get decompressed.
+// Returns 0, 1 if the old archive can't be read or 2 if the new one can't.
+int diff_archives(ArchiveDiff& diff, DiffProgress* progress) {
+	NS_PROFILE_SCOPE("diff_archives");
+	PreLayout old_layout;
+	PreLayout new_layout;
+	if (!old_layout.read(diff.old_path)) {
+		return 1;
+	}
+	if (!new_layout.read(diff.new_path)) {
+		return 2;
+	}
+
+	auto& old_entries = old_layout.entries();
+	auto& new_entries = new_layout.entries();
+	std::unordered_map<std::string,uint32_t> new_by_path;
+	new_by_path.reserve(new_entries.size());
+	for (size_t i = 0; i < new_entries.size(); ++i) {
+		new_by_path.emplace(new_entries[i].prepath, i);
+	}
+
+	diff.entries.clear();
+	std::vector<char> matched(new_entries.size(), 0);
+	std::vector<DiffPair> pairs;
+	for (size_t i = 0; i < old_entries.size(); ++i) {
+		const PreLayoutEntry& o = old_entries[i];
+		DiffEntry d;
+		d.prepath = o.prepath;
+		d.old_size = o.size;
+		d.old_cmp_size = o.cmp_size;
+
+		auto it = new_by_path.find(o.prepath);
+		if (it == new_by_path.end()) {
+			d.change = DIFF_REMOVED;
+		}
+		else {
+			const PreLayoutEntry& n = new_entries[it->second];
+			matched[it->second] = 1;
+			d.new_size = n.size;
+			d.new_cmp_size = n.cmp_size;
+			d.change = (o.size == n.size) ? DIFF_UNCHANGED : DIFF_MODIFIED;
+			if (d.change == DIFF_UNCHANGED) {
+				pairs.push_back({(uint32_t)diff.entries.size(), (uint32_t)i, it->second});
+			}
+		}
+
+		diff.entries.push_back(std::move(d));
+	}
+
+	for (size_t i = 0; i < new_entries.size(); ++i) {
+		if (!matched[i]) {
+			DiffEntry d;
+			d.prepath = new_entries[i].prepath;
+			d.change = DIFF_ADDED;
+			d.new_size = new_entries[i].size;
+			d.new_cmp_size = new_entries[i].cmp_size;
+			diff.entries.push_back(std::move(d));
+		}
+	}
+
+	if (progress) {
+		progress->total = pairs.size();
+	}
+
+	int old_fd = open(diff.old_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (old_fd < 0) {
+		return 1;
+	}
+	int new_fd = open(diff.new_path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (new_fd < 0) {
+		close(old_fd);
+		return 2;
+	}
+
+	std::atomic<size_t> next{0};
+	std::atomic<uint32_t> skipped{0};
+	std::atomic<uint32_t> decompressed{0};
+	worker_pool.run_parallel([&]() {
+		NS_PROFILE_SCOPE("diff_entries");
+		DiffWorker w(diff);
+		size_t i;
+		while ((i = next++) < pairs.size()) {
+			const DiffPair& p = pairs[i];
+			const PreLayoutEntry& o = old_entries[p.old_index];
+			const PreLayoutEntry& n = new_entries[p.new_index];
+			DiffEntry& d = diff.entries[p.entry];
+
+			if (o.stored() == n.stored() && o.data_size() == n.data_size() && w.same_bytes(old_fd, o, new_fd, n)) {
+				d.change = DIFF_UNCHANGED;
+				++skipped;
+			}
+			else if (o.stored() && n.stored()) {
+				d.hashed = hash_entry(old_fd, o, w.buf_a, d.old_hash) && hash_entry(new_fd, n, w.buf_a, d.new_hash);
+				d.change = DIFF_MODIFIED;
+			}
+			else {
+				d.hashed = w.open_readers() &&
+					w.content_hash(w.old_reader, p.old_index, o.prepath, d.old_hash) &&
+					w.content_hash(w.new_reader, p.new_index, n.prepath, d.new_hash);
+				d.change = (d.hashed && d.old_hash == d.new_hash) ? DIFF_UNCHANGED : DIFF_MODIFIED;
+				++decompressed;
+			}
+
+			if (progress) {
+				++progress->done;
+			}
+		}
+	});
+
+	close(old_fd);
+	close(new_fd);
+
+	std::sort(diff.entries.begin(), diff.entries.end(), [](const DiffEntry& a, const DiffEntry& b) {
+		return a.prepath < b.prepath;
+	});
+
+	diff.added = diff.removed = diff.modified = diff.unchanged = 0;
+	for (auto& d : diff.entries) {
+		if (d.change == DIFF_ADDED) ++diff.added;
+		else if (d.change == DIFF_REMOVED) ++diff.removed;
+		else if (d.change == DIFF_MODIFIED) ++diff.modified;
+		else ++diff.unchanged;
+	}
+	diff.skipped = skipped;
+	diff.decompressed = decompressed;
+
+	return 0;
+}
+
+}
@@ -0,0 +1,536 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+// The index is a cache, it's stored in host byte order and rebuilt by a scan
+// if it doesn't load
+static const char INDEX_MAGIC[4] = {'N','S','I','X'};
+static const uint32_t INDEX_VERSION = 1;
+
+// Parsed archives between progress updates
+static const uint32_t INDEX_PUBLISH_INTERVAL = 64;
+
+static std::string fold_name(const std::string& name) {
+	std::string folded(name);
+	for (char& c : folded) {
+		if (c == '\\') {
+			c = '/';
+		}
+		else if (c >= 'A' && c <= 'Z') {
+			c += 'a' - 'A';
+		}
+	}
+
+	return folded;
+}
+
+fs::path index_file() {
+	const char* cache = std::getenv("XDG_CACHE_HOME");
+	if (cache && cache[0]) {
+		return fs::path(cache) / "nspre-gui" / "archive-index.bin";
+	}
+
+	const char* home = std::getenv("HOME");
+	if (home && home[0]) {
+		return fs::path(home) / ".cache" / "nspre-gui" / "archive-index.bin";
+	}
+
+	return fs::path();
+}
+
+void ArchiveIndex::add_archive(const IndexedArchive& archive) {
+	m_archives.push_back(archive);
+	m_archives.back().first_entry = m_entries.size();
+	m_archives.back().entries = 0;
+}
+
+void ArchiveIndex::add_entry(const std::string& name, uint32_t size, uint32_t cmp_size) {
+	IndexedEntry e;
+	e.archive = m_archives.size() - 1;
+	e.size = size;
+	e.cmp_size = cmp_size;
+	e.name_offset = m_names.size();
+	e.name_size = name.size();
+	m_entries.push_back(e);
+	++m_archives.back().entries;
+
+	m_names += name;
+	m_names += '\n';
+	m_folded += fold_name(name);
+	m_folded += '\n';
+}
+
+std::string ArchiveIndex::name(uint32_t entry) const {
+	const IndexedEntry& e = m_entries[entry];
+	return m_names.substr(e.name_offset, e.name_size);
+}
+
+// Case insensitive substring match over every internal path, '\' and '/'
+// are treated the same
+void ArchiveIndex::search(const std::string& query, std::vector<uint32_t>& out, size_t limit) const {
+	out.clear();
+	std::string q = fold_name(query);
+	if (q.empty()) {
+		return;
+	}
+
+	const char* base = m_folded.data();
+	size_t size = m_folded.size();
+	size_t pos = 0;
+	while (out.size() < limit && pos < size) {
+		const char* hit = (const char*)memmem(base + pos, size - pos, q.data(), q.size());
+		if (!hit) {
+			break;
+		}
+
+		uint64_t offset = hit - base;
+		auto it = std::upper_bound(m_entries.begin(), m_entries.end(), offset, [](uint64_t o, const IndexedEntry& e) {
+			return o < e.name_offset;
+		});
+
+		const IndexedEntry& e = *(it - 1);
+		out.push_back((it - 1) - m_entries.begin());
+		pos = e.name_offset + e.name_size + 1;
+	}
+}
+
+template<class T> static void put(std::string& out, T v) {
+	out.append((const char*)&v, sizeof(v));
+}
+
+template<class T> static bool get(const std::string& in, size_t& pos, T& v) {
+	if (in.size() - pos < sizeof(v)) {
+		return false;
+	}
+
+	std::memcpy(&v, in.data() + pos, sizeof(v));
+	pos += sizeof(v);
+	return true;
+}
+
+static bool get_string(const std::string& in, size_t& pos, std::string& s, size_t size) {
+	if (in.size() - pos < size) {
+		return false;
+	}
+
+	s.assign(in, pos, size);
+	pos += size;
+	return true;
+}
+
+bool ArchiveIndex::save(const fs::path& path) const {
+	std::string out;
+	out.reserve(64 + m_archives.size() * 64 + m_entries.size() * 16 + m_names.size());
+	out.append(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	put<uint32_t>(out, INDEX_VERSION);
+	put<uint32_t>(out, m_root.size());
+	out += m_root;
+	put<uint32_t>(out, m_archives.size());
+	put<uint64_t>(out, m_entries.size());
+	put<uint64_t>(out, m_names.size());
+
+	for (auto& a : m_archives) {
+		put<uint32_t>(out, a.path.size());
+		out += a.path;
+		put<uint64_t>(out, a.size);
+		put<int64_t>(out, a.mtime_ns);
+		put<uint32_t>(out, a.entries);
+	}
+
+	for (auto& e : m_entries) {
+		put<uint32_t>(out, e.size);
+		put<uint32_t>(out, e.cmp_size);
+		put<uint32_t>(out, e.name_size);
+	}
+
+	out += m_names;
+
+	// Written next to the old one and renamed over it, so a crash mid-write
+	// leaves the previous index intact
+	std::error_code ec;
+	fs::create_directories(path.parent_path(), ec);
+	fs::path tmp = path;
+	tmp += ".tmp";
+
+	std::FILE* f = std::fopen(tmp.c_str(), "wb");
+	if (!f) {
+		return false;
+	}
+
+	bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+	ok = (std::fclose(f) == 0) && ok;
+	if (ok) {
+		fs::rename(tmp, path, ec);
+		ok = !ec;
+	}
+	if (!ok) {
+		fs::remove(tmp, ec);
+	}
+
+	return ok;
+}
+
+bool ArchiveIndex::load(const fs::path& path) {
+	std::string in;
+	std::FILE* f = std::fopen(path.c_str(), "rb");
+	if (!f) {
+		return false;
+	}
+
+	char buf[1 << 16];
+	size_t n;
+	while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+		in.append(buf, n);
+	}
+	std::fclose(f);
+
+	size_t pos = 0;
+	uint32_t version, root_size, archive_count;
+	uint64_t entry_count, names_size;
+	if (in.size() < sizeof(INDEX_MAGIC) || std::memcmp(in.data(), INDEX_MAGIC, sizeof(INDEX_MAGIC))) {
+		return false;
+	}
+	pos += sizeof(INDEX_MAGIC);
+
+	if (!get(in, pos, version) || version != INDEX_VERSION ||
+		!get(in, pos, root_size) || !get_string(in, pos, m_root, root_size) ||
+		!get(in, pos, archive_count) || !get(in, pos, entry_count) || !get(in, pos, names_size)
+	) {
+		return false;
+	}
+
+	std::vector<IndexedArchive> archives(archive_count);
+	uint64_t total = 0;
+	for (auto& a : archives) {
+		uint32_t path_size;
+		if (!get(in, pos, path_size) || !get_string(in, pos, a.path, path_size) ||
+			!get(in, pos, a.size) || !get(in, pos, a.mtime_ns) || !get(in, pos, a.entries)
+		) {
+			return false;
+		}
+
+		a.first_entry = total;
+		total += a.entries;
+	}
+
+	if (total != entry_count || in.size() - pos < entry_count * 12 + names_size) {
+		return false;
+	}
+
+	std::vector<IndexedEntry> entries(entry_count);
+	uint64_t offset = 0;
+	uint32_t archive = 0;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		IndexedEntry& e = entries[i];
+		while (archives[archive].first_entry + archives[archive].entries <= i) {
+			++archive;
+		}
+
+		get(in, pos, e.size);
+		get(in, pos, e.cmp_size);
+		get(in, pos, e.name_size);
+		e.archive = archive;
+		e.name_offset = offset;
+		offset += e.name_size + 1;
+	}
+
+	if (offset != names_size) {
+		return false;
+	}
+
+	m_archives = std::move(archives);
+	m_entries = std::move(entries);
+	m_names.assign(in, pos, names_size);
+	m_folded = fold_name(m_names);
+	return true;
+}
+
+namespace {
+
+struct ParsedEntry {
+	std::string name;
+	uint32_t size;
+	uint32_t cmp_size;
+};
+
+// One scan, shared by the jobs parsing its archives. Whichever job finishes
+// last assembles the index.
+struct IndexScan {
+	std::function<bool()> current;
+	std::function<void(uint32_t parsed, uint32_t total)> publish;
+	std::function<void(std::shared_ptr<const ArchiveIndex>)> finish;
+	std::string root;
+	fs::path file;
+	std::shared_ptr<const ArchiveIndex> previous;
+	std::vector<IndexedArchive> archives;
+	std::vector<int64_t> reuse;
+	std::vector<std::vector<ParsedEntry>> parsed;
+	std::vector<char> valid;
+	std::atomic<size_t> next{0};
+	std::atomic<uint32_t> done{0};
+	std::atomic<unsigned> running{0};
+	uint64_t start_ns = 0;
+};
+
+}
+
+static bool under_root(const std::string& path, const std::string& root) {
+	return path.size() > root.size() && path.compare(0, root.size(), root) == 0 && path[root.size()] == '/';
+}
+
+static void copy_archive(ArchiveIndex& index, const ArchiveIndex& from, const IndexedArchive& a) {
+	index.add_archive(a);
+	for (uint32_t i = a.first_entry; i < a.first_entry + a.entries; ++i) {
+		const IndexedEntry& e = from.entries()[i];
+		index.add_entry(from.name(i), e.size, e.cmp_size);
+	}
+}
+
+static void finish_scan(IndexScan& scan) {
+	NS_PROFILE_SCOPE("build_index");
+	auto index = std::make_shared<ArchiveIndex>();
+	index->set_root(scan.root);
+
+	// Archives from other folders stay in the index
+	uint32_t reused = 0;
+	if (scan.previous) {
+		for (auto& a : scan.previous->archives()) {
+			if (!under_root(a.path, scan.root)) {
+				copy_archive(*index, *scan.previous, a);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < scan.archives.size(); ++i) {
+		if (scan.reuse[i] >= 0) {
+			copy_archive(*index, *scan.previous, scan.previous->archives()[scan.reuse[i]]);
+			++reused;
+		}
+		else if (scan.valid[i]) {
+			index->add_archive(scan.archives[i]);
+			for (auto& e : scan.parsed[i]) {
+				index->add_entry(e.name, e.size, e.cmp_size);
+			}
+		}
+	}
+
+	if (!scan.file.empty() && !index->save(scan.file)) {
+		std::fprintf(stderr, "Can't write index file \"%s\"\n", scan.file.c_str());
+	}
+
+	std::printf("Indexed %zu archives under \"%s\" (%u unchanged), %zu entries in %.2f s\n",
+		scan.archives.size(), scan.root.c_str(), reused, index->entries().size(),
+		(Profiler::now_ns() - scan.start_ns) / 1e9);
+	scan.finish(index);
+}
+
+static void parse_archives(std::shared_ptr<IndexScan> scan) {
+	NS_PROFILE_SCOPE("index_archives");
+	size_t i;
+	while ((i = scan->next++) < scan->archives.size() && scan->current()) {
+		if (scan->reuse[i] < 0) {
+			std::vector<ParsedEntry>& entries = scan->parsed[i];
+			PreLayout layout;
+			scan->valid[i] = layout.read(scan->archives[i].path, [&entries](const PreLayoutEntry& e, uint32_t count) {
+				entries.push_back({e.prepath, e.size, e.cmp_size});
+				return true;
+			});
+			if (!scan->valid[i]) {
+				entries.clear();
+			}
+		}
+
+		uint32_t done = ++scan->done;
+		if (done % INDEX_PUBLISH_INTERVAL == 0) {
+			scan->publish(done, scan->archives.size());
+		}
+	}
+
+	if (--scan->running == 0 && scan->current()) {
+		finish_scan(*scan);
+	}
+}
+
+void ArchiveIndexer::load(const fs::path& file) {
+	unsigned generation;
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		m_state->progress = IndexProgress();
+		generation = ++m_state->generation;
+	}
+
+	std::shared_ptr<State> state = m_state;
+	worker_pool.submit([state, generation, file]() {
+		NS_PROFILE_SCOPE("load_index");
+		auto index = std::make_shared<ArchiveIndex>();
+		bool ok = index->load(file);
+
+		std::lock_guard<std::mutex> lock(state->mutex);
+		if (generation == state->generation) {
+			if (ok) {
+				state->progress.index = std::move(index);
+			}
+			state->progress.done = true;
+			request_redraw();
+		}
+	});
+}
+
+void ArchiveIndexer::scan(const fs::path& root, std::shared_ptr<const ArchiveIndex> previous, const fs::path& file) {
+	unsigned generation;
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		m_state->progress = IndexProgress();
+		m_state->progress.scanning = true;
+		generation = ++m_state->generation;
+	}
+
+	auto scan = std::make_shared<IndexScan>();
+	std::shared_ptr<State> state = m_state;
+	scan->current = [state, generation]() {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		return generation == state->generation;
+	};
+	scan->publish = [state, generation](uint32_t parsed, uint32_t total) {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		if (generation == state->generation) {
+			state->progress.parsed = parsed;
+			state->progress.total = total;
+			request_redraw();
+		}
+	};
+	scan->finish = [state, generation](std::shared_ptr<const ArchiveIndex> index) {
+		std::lock_guard<std::mutex> lock(state->mutex);
+		if (generation == state->generation) {
+			state->progress.index = std::move(index);
+			state->progress.scanning = false;
+			state->progress.done = true;
+			request_redraw();
+		}
+	};
+
+	std::error_code ec;
+	scan->root = fs::absolute(root, ec).lexically_normal().string();
+	while (scan->root.size() > 1 && scan->root.back() == '/') {
+		scan->root.pop_back();
+	}
+	scan->file = file;
+	scan->previous = std::move(previous);
+
+	// Walking the tree is serial, parsing is spread over the pool once the
+	// list of archives is known
+	worker_pool.submit([scan]() {
+		NS_PROFILE_SCOPE("walk_index");
+		scan->start_ns = Profiler::now_ns();
+
+		std::map<std::string,int64_t> known;
+		if (scan->previous) {
+			auto& archives = scan->previous->archives();
+			for (size_t i = 0; i < archives.size(); ++i) {
+				known[archives[i].path] = i;
+			}
+		}
+
+		std::error_code ec;
+		auto options = fs::directory_options::skip_permission_denied;
+		for (fs::recursive_directory_iterator it(scan->root, options, ec), end; !ec && it != end; it.increment(ec)) {
+			std::string ext = fold_name(it->path().extension().string());
+			if (ext != ".pre" && ext != ".prx") {
+				continue;
+			}
+
+			struct stat st;
+			if (stat(it->path().c_str(), &st) || !S_ISREG(st.st_mode)) {
+				continue;
+			}
+
+			IndexedArchive a;
+			a.path = it->path().string();
+			a.size = st.st_size;
+			a.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+			scan->archives.push_back(std::move(a));
+
+			if (scan->archives.size() % 1024 == 0 && !scan->current()) {
+				return;
+			}
+		}
+
+		std::sort(scan->archives.begin(), scan->archives.end(), [](const IndexedArchive& a, const IndexedArchive& b) {
+			return a.path < b.path;
+		});
+
+		// Unchanged archives are carried over from the previous index
+		scan->reuse.assign(scan->archives.size(), -1);
+		for (size_t i = 0; i < scan->archives.size(); ++i) {
+			auto it = known.find(scan->archives[i].path);
+			if (it != known.end()) {
+				const IndexedArchive& old = scan->previous->archives()[it->second];
+				if (old.size == scan->archives[i].size && old.mtime_ns == scan->archives[i].mtime_ns) {
+					scan->reuse[i] = it->second;
+				}
+			}
+		}
+
+		scan->parsed.resize(scan->archives.size());
+		scan->valid.assign(scan->archives.size(), 0);
+		scan->publish(0, scan->archives.size());
+
+		unsigned jobs = worker_pool.threads();
+		scan->running = jobs;
+		for (unsigned i = 0; i < jobs; ++i) {
+			worker_pool.submit([scan]() { parse_archives(scan); });
+		}
+	});
+}
+
+void ArchiveIndexer::cancel() {
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	m_state->progress = IndexProgress();
+	++m_state->generation;
+}
+
+void ArchiveIndexer::poll(IndexProgress& out) {
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	out.parsed = m_state->progress.parsed;
+	out.total = m_state->progress.total;
+	out.scanning = m_state->progress.scanning;
+	out.done = m_state->progress.done;
+	out.index = std::move(m_state->progress.index);
+	m_state->progress.done = false;
+}
+
+ArchiveIndexer::ArchiveIndexer() : m_state(std::make_shared<State>()) {
+
+}
+
+ArchiveIndexer::~ArchiveIndexer() {
+	cancel();
+}
+
+}
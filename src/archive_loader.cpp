@@ -0,0 +1,135 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+static const size_t LOAD_BATCH_SIZE = 512;
+
+void ArchiveLoader::run(std::shared_ptr<State> state, unsigned generation, fs::path path, bool layout) {
+	NS_PROFILE_SCOPE("load_archive");
+	OperationTimer timer("open", path, true);
+	std::vector<PreLayoutEntry> batch;
+
+	auto publish = [&](uint32_t total) {
+		std::lock_guard<std::mutex> guard(state->mutex);
+		if (generation != state->generation) {
+			return false;
+		}
+
+		state->progress.entries.insert(state->progress.entries.end(), batch.begin(), batch.end());
+		state->progress.total = total;
+		batch.clear();
+		request_redraw();
+		return true;
+	};
+
+	// If the layout can't be parsed, nspre still gets the final say below
+	uint32_t total = 0;
+	bool current = true;
+	if (layout) {
+		PreLayout pre_layout;
+		pre_layout.read(path, [&](const PreLayoutEntry& e, uint32_t count) {
+			total = count;
+			batch.push_back(e);
+			if (batch.size() == LOAD_BATCH_SIZE) {
+				current = publish(count);
+			}
+			return current;
+		});
+
+		if (current && batch.size()) {
+			current = publish(total);
+		}
+	}
+	else {
+		std::lock_guard<std::mutex> guard(state->mutex);
+		current = generation == state->generation;
+	}
+
+	// nspre can't be interrupted, a superseded open is thrown away once it
+	// returns
+	if (!current) {
+		return;
+	}
+
+	auto reader = std::make_unique<nspre::Reader>();
+	int err;
+	{
+		NS_PROFILE_SCOPE("open_pre");
+		err = reader->open(path);
+	}
+	uint64_t entries = err ? 0 : reader->files().size();
+
+	std::lock_guard<std::mutex> guard(state->mutex);
+	if (generation == state->generation) {
+		state->progress.reader = std::move(reader);
+		state->progress.error = err;
+		state->progress.done = true;
+		request_redraw();
+		timer.finish(entries, err == 0);
+	}
+}
+
+// With layout false only the reader is opened, for archives whose entry
+// table is already known
+void ArchiveLoader::open(const std::filesystem::path& path, bool layout) {
+	unsigned generation;
+	{
+		std::lock_guard<std::mutex> lock(m_state->mutex);
+		m_state->progress = LoadProgress();
+		generation = ++m_state->generation;
+	}
+
+	std::shared_ptr<State> state = m_state;
+	worker_pool.submit([state, generation, path, layout]() {
+		run(state, generation, path, layout);
+	});
+}
+
+void ArchiveLoader::cancel() {
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	m_state->progress = LoadProgress();
+	++m_state->generation;
+}
+
+void ArchiveLoader::poll(LoadProgress& out) {
+	out.entries.clear();
+	std::lock_guard<std::mutex> lock(m_state->mutex);
+	out.entries.swap(m_state->progress.entries);
+	out.total = m_state->progress.total;
+	out.done = m_state->progress.done;
+	out.error = m_state->progress.error;
+	out.reader = std::move(m_state->progress.reader);
+	m_state->progress.done = false;
+}
+
+ArchiveLoader::ArchiveLoader() : m_state(std::make_shared<State>()) {
+
+}
+
+ArchiveLoader::~ArchiveLoader() {
+	cancel();
+}
+
+}
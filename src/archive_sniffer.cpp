@@ -0,0 +1,129 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+static bool archive_key(const fs::path& path, ArchiveKey& key) {
+	struct stat st;
+	if (stat(path.c_str(), &st) || !S_ISREG(st.st_mode)) {
+		return false;
+	}
+
+	key.dev = st.st_dev;
+	key.ino = st.st_ino;
+	key.size = st.st_size;
+	key.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	return true;
+}
+
+static ArchiveInfo sniff_archive(const fs::path& path) {
+	NS_PROFILE_SCOPE("sniff_archive");
+	ArchiveInfo info;
+	PreLayout layout;
+	if (!layout.read(path)) {
+		return info;
+	}
+
+	info.valid = true;
+	info.entries = layout.entries().size();
+	for (auto& e : layout.entries()) {
+		info.size += e.size;
+		info.packed_size += e.data_size();
+	}
+
+	return info;
+}
+
+void ArchiveSniffer::run() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_quit) {
+		if (m_queue_pos >= m_queue.size()) {
+			m_cv.wait(lock);
+			continue;
+		}
+
+		unsigned generation = m_generation;
+		size_t index = m_queue_pos++;
+		fs::path path = m_queue[index];
+
+		ArchiveKey key;
+		bool have_key = archive_key(path, key);
+		ArchiveInfo info;
+		if (have_key) {
+			auto it = m_cache.find(key);
+			if (it != m_cache.end()) {
+				info = it->second;
+			}
+			else {
+				lock.unlock();
+				info = sniff_archive(path);
+				lock.lock();
+				m_cache[key] = info;
+			}
+		}
+
+		// The directory may have changed while the lock was released
+		if (generation == m_generation) {
+			m_results.push_back({index, info});
+			request_redraw();
+		}
+	}
+}
+
+void ArchiveSniffer::request(const std::vector<std::filesystem::path>& paths) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue = paths;
+		m_queue_pos = 0;
+		m_results.clear();
+		++m_generation;
+	}
+
+	if (!m_worker.joinable()) {
+		m_worker = std::thread(&ArchiveSniffer::run, this);
+	}
+
+	m_cv.notify_one();
+}
+
+void ArchiveSniffer::poll(std::vector<std::pair<size_t,ArchiveInfo>>& out) {
+	out.clear();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	out.swap(m_results);
+}
+
+ArchiveSniffer::~ArchiveSniffer() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+
+	m_cv.notify_one();
+	if (m_worker.joinable()) {
+		m_worker.join();
+	}
+}
+
+}
@@ -0,0 +1,177 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <chrono>
+#include <cerrno>
+#include <poll.h>
+#include <set>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+static const uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ATTRIB;
+
+void ArchiveWatcher::build(PackCache& cache) {
+	NS_PROFILE_SCOPE("watch_rebuild");
+	auto start = std::chrono::steady_clock::now();
+	PackStats stats;
+	OperationTimer timer("rebuild", m_out);
+	EstimatorPause pause;
+	int err = rebuild_pre(m_subfiles, m_out, m_options, cache, &stats);
+	timer.finish(m_subfiles.size(), err == 0);
+	float ms = std::chrono::duration<float,std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		++m_status.builds;
+		m_status.error = err;
+		m_status.build_ms = ms;
+		m_status.stats = stats;
+	}
+
+	if (err == nspre::Error::FILE_OPEN) {
+		std::fprintf(stderr, "Error rebuilding \"%s\", an input can't be read\n", m_out.c_str());
+	}
+	else if (err) {
+		std::fprintf(stderr, "Error writing to file \"%s\"\n", m_out.c_str());
+	}
+	else {
+		std::printf("Rebuilt \"%s\" in %.0f ms (%llu packed, %llu reused)\n", m_out.c_str(), ms,
+			(unsigned long long)(stats.compressed + stats.stored), (unsigned long long)stats.reused);
+		std::fflush(stdout);
+	}
+	request_redraw();
+}
+
+void ArchiveWatcher::run(int inotify) {
+	std::map<int,std::set<std::string>> watched;
+	for (const nspre::Subfile& subfile : m_subfiles) {
+		fs::path dir = subfile.path.parent_path();
+		int wd = inotify_add_watch(inotify, dir.empty() ? "." : dir.c_str(), WATCH_EVENTS);
+		if (wd >= 0) {
+			watched[wd].insert(subfile.path.filename().string());
+		}
+	}
+
+	PackCache cache;
+	build(cache);
+
+	typedef std::chrono::steady_clock clock;
+	bool pending = false;
+	clock::time_point deadline;
+	alignas(struct inotify_event) char buf[16384];
+
+	for (;;) {
+		int timeout = -1;
+		if (pending) {
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now()).count();
+			timeout = left > 0 ? left : 0;
+		}
+
+		struct pollfd fds[2] = {{m_wake, POLLIN, 0}, {inotify, POLLIN, 0}};
+		int n = poll(fds, 2, timeout);
+		if (n < 0 && errno != EINTR) {
+			break;
+		}
+		if (fds[0].revents) {
+			break;
+		}
+
+		if (fds[1].revents & POLLIN) {
+			ssize_t len = read(inotify, buf, sizeof(buf));
+			for (ssize_t i = 0; i < len;) {
+				const struct inotify_event* e = (const struct inotify_event*)(buf + i);
+				auto it = watched.find(e->wd);
+				if ((e->mask & IN_Q_OVERFLOW) || (e->len && it != watched.end() && it->second.count(e->name))) {
+					pending = true;
+					deadline = clock::now() + std::chrono::milliseconds(NSPRE_GUI_WATCH_DEBOUNCE_MS);
+				}
+				i += sizeof(struct inotify_event) + e->len;
+			}
+		}
+
+		if (pending && clock::now() >= deadline) {
+			pending = false;
+			build(cache);
+		}
+	}
+
+	close(inotify);
+}
+
+// The first build happens straight away on the watcher thread
+bool ArchiveWatcher::start(const std::vector<nspre::Subfile>& subfiles, const std::filesystem::path& out, const PackOptions& options) {
+	stop();
+
+	int inotify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (inotify < 0) {
+		return false;
+	}
+	m_wake = eventfd(0, EFD_CLOEXEC);
+	if (m_wake < 0) {
+		close(inotify);
+		return false;
+	}
+
+	m_subfiles = subfiles;
+	m_out = out;
+	m_options = options;
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		m_status = WatchStatus();
+		m_status.watching = true;
+	}
+
+	m_thread = std::thread(&ArchiveWatcher::run, this, inotify);
+	return true;
+}
+
+void ArchiveWatcher::stop() {
+	if (!m_thread.joinable()) {
+		return;
+	}
+
+	uint64_t one = 1;
+	if (write(m_wake, &one, sizeof(one)) != sizeof(one)) {
+		std::fprintf(stderr, "Can't wake archive watcher\n");
+	}
+	m_thread.join();
+	close(m_wake);
+	m_wake = -1;
+
+	std::lock_guard<std::mutex> guard(m_mutex);
+	m_status.watching = false;
+}
+
+WatchStatus ArchiveWatcher::status() {
+	std::lock_guard<std::mutex> guard(m_mutex);
+	return m_status;
+}
+
+ArchiveWatcher::~ArchiveWatcher() {
+	stop();
+}
+
+}
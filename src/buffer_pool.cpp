@@ -0,0 +1,137 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+
+#include <algorithm>
+
+namespace ns {
+
+static const unsigned MIN_CLASS = 12;
+static const unsigned MAX_CLASS = 26;
+static const size_t BUFFERS_PER_CLASS = 4;
+
+static std::atomic<uint64_t> s_takes{0};
+static std::atomic<uint64_t> s_reuses{0};
+static std::atomic<uint64_t> s_in_use{0};
+static std::atomic<uint64_t> s_peak_in_use{0};
+static std::atomic<uint64_t> s_cached{0};
+static std::atomic<uint64_t> s_peak_cached{0};
+
+static void raise_peak(std::atomic<uint64_t>& peak, uint64_t value) {
+	uint64_t old = peak.load(std::memory_order_relaxed);
+	while (value > old && !peak.compare_exchange_weak(old, value, std::memory_order_relaxed)) {
+	}
+}
+
+static unsigned size_class(size_t size) {
+	unsigned c = MIN_CLASS;
+	while (c < MAX_CLASS && ((size_t)1 << c) < size) {
+		++c;
+	}
+
+	return c;
+}
+
+struct ThreadBuffers {
+	std::vector<std::vector<char>> free[MAX_CLASS + 1];
+	uint64_t cached = 0;
+
+	~ThreadBuffers() {
+		s_cached -= cached;
+	}
+};
+
+static ThreadBuffers& thread_buffers() {
+	thread_local ThreadBuffers buffers;
+	return buffers;
+}
+
+// Anything over the biggest class is allocated to size and freed on give()
+std::vector<char> BufferPool::take(size_t size) {
+	std::vector<char> buffer;
+	if (!size) {
+		return buffer;
+	}
+
+	++s_takes;
+	if (size <= ((size_t)1 << MAX_CLASS)) {
+		ThreadBuffers& t = thread_buffers();
+		auto& list = t.free[size_class(size)];
+		if (list.size()) {
+			buffer = std::move(list.back());
+			list.pop_back();
+			t.cached -= buffer.capacity();
+			s_cached -= buffer.capacity();
+			++s_reuses;
+		}
+		else {
+			buffer.reserve((size_t)1 << size_class(size));
+		}
+	}
+
+	buffer.resize(size);
+	raise_peak(s_peak_in_use, s_in_use += buffer.capacity());
+	return buffer;
+}
+
+void BufferPool::give(std::vector<char>&& buffer) {
+	size_t capacity = buffer.capacity();
+	if (!capacity) {
+		return;
+	}
+
+	s_in_use -= std::min<uint64_t>(capacity, s_in_use);
+	ThreadBuffers& t = thread_buffers();
+	unsigned c = size_class(capacity);
+	bool exact = capacity == ((size_t)1 << c);
+	if (!exact || capacity > ((size_t)1 << MAX_CLASS) || t.free[c].size() >= BUFFERS_PER_CLASS ||
+		t.cached + capacity > ((uint64_t)NSPRE_GUI_BUFFER_CACHE << 20)) {
+		std::vector<char>().swap(buffer);
+		return;
+	}
+
+	t.free[c].push_back(std::move(buffer));
+	t.cached += capacity;
+	raise_peak(s_peak_cached, s_cached += capacity);
+}
+
+void BufferPool::fit(std::vector<char>& buffer, size_t size) {
+	if (size <= buffer.capacity()) {
+		buffer.resize(size);
+		return;
+	}
+
+	give(std::move(buffer));
+	buffer = take(size);
+}
+
+BufferPoolStats BufferPool::stats() {
+	BufferPoolStats stats;
+	stats.takes = s_takes;
+	stats.reuses = s_reuses;
+	stats.in_use = s_in_use;
+	stats.peak_in_use = s_peak_in_use;
+	stats.cached = s_cached;
+	stats.peak_cached = s_peak_cached;
+	return stats;
+}
+
+}
@@ -0,0 +1,219 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace ns {
+
+// nspre stores an entry as is when it doesn't compress
+uint64_t SizeEstimate::estimate() const {
+	if (!sampled) {
+		return size;
+	}
+
+	uint64_t estimate = (double)size * compressed / sampled;
+	return std::min(estimate, size);
+}
+
+static uint64_t padded(uint64_t size) {
+	return (size + 3) & ~(uint64_t)3;
+}
+
+uint32_t CreateList::store(const char* str, size_t size) {
+	uint32_t offset = m_arena.size();
+	m_arena.insert(m_arena.end(), str, str + size);
+	m_arena.push_back(0);
+	return offset;
+}
+
+// Rewrites the arena with only the strings still in use
+void CreateList::compact() {
+	std::vector<char> arena;
+	arena.reserve(m_arena.size() - m_garbage);
+	for (size_t i = 0; i < size(); ++i) {
+		const char* source = this->source(i);
+		const char* ipath = this->ipath(i);
+		uint32_t name = m_name[i] - m_source[i];
+		size_t source_size = std::strlen(source) + 1;
+		size_t ipath_size = std::strlen(ipath) + 1;
+
+		m_source[i] = arena.size();
+		m_name[i] = m_source[i] + name;
+		arena.insert(arena.end(), source, source + source_size);
+		m_ipath[i] = arena.size();
+		arena.insert(arena.end(), ipath, ipath + ipath_size);
+	}
+
+	m_arena = std::move(arena);
+	m_garbage = 0;
+}
+
+// Rows only ever get appended or removed, so ids stay in ascending order
+int64_t CreateList::find(uint32_t id) const {
+	auto it = std::lower_bound(m_id.begin(), m_id.end(), id);
+	if (it == m_id.end() || *it != id) {
+		return -1;
+	}
+
+	return it - m_id.begin();
+}
+
+// File header, then an entry header, the name and the padded data per row
+uint64_t CreateList::projected_size() const {
+	return 12 + size() * 17 + m_ipath_bytes + m_estimated_bytes;
+}
+
+uint32_t CreateList::add(const std::filesystem::path& source, const std::string& ipath) {
+	const std::string& str = source.native();
+	size_t slash = str.find_last_of('/');
+	m_source.push_back(store(str.data(), str.size()));
+	m_name.push_back(m_source.back() + (slash == std::string::npos ? 0 : slash + 1));
+	m_ipath.push_back(store(ipath.data(), ipath.size()));
+	m_selected.push_back(0);
+	m_id.push_back(m_next_id++);
+	m_estimate.push_back(SizeEstimate());
+	m_ipath_bytes += ipath.size();
+	if (ipath.empty()) {
+		++m_empty;
+	}
+
+	return m_id.back();
+}
+
+void CreateList::set_estimate(size_t i, const SizeEstimate& estimate) {
+	m_estimated_bytes -= padded(m_estimate[i].estimate());
+	m_estimated += (size_t)estimate.known() - (size_t)m_estimate[i].known();
+	m_estimate[i] = estimate;
+	m_estimated_bytes += padded(estimate.estimate());
+}
+
+void CreateList::set_ipath(size_t i, const std::string& ipath) {
+	const char* old = this->ipath(i);
+	size_t old_size = std::strlen(old);
+	if (old == ipath) {
+		return;
+	}
+
+	if (old_size == 0) {
+		--m_empty;
+	}
+	if (ipath.empty()) {
+		++m_empty;
+	}
+
+	m_garbage += old_size + 1;
+	m_ipath_bytes += ipath.size() - old_size;
+	m_ipath[i] = store(ipath.data(), ipath.size());
+	if (m_garbage > m_arena.size() / 2) {
+		compact();
+	}
+}
+
+void CreateList::select(size_t i, bool selected) {
+	if ((bool)m_selected[i] != selected) {
+		m_selected[i] = selected;
+		if (selected) {
+			++m_selected_count;
+		}
+		else {
+			--m_selected_count;
+		}
+	}
+}
+
+void CreateList::select_all(bool selected) {
+	std::fill(m_selected.begin(), m_selected.end(), selected);
+	m_selected_count = selected ? size() : 0;
+}
+
+// Drops row first, or with selected_only every selected row from first on,
+// in one pass over the columns. Rows before first don't move. The ids of
+// dropped rows are appended to removed, in ascending order.
+void CreateList::remove_rows(size_t first, bool selected_only, std::vector<uint32_t>& removed) {
+	size_t kept = first;
+	for (size_t i = first; i < size(); ++i) {
+		if (selected_only ? m_selected[i] : i == first) {
+			size_t ipath_size = std::strlen(ipath(i));
+			if (ipath_size == 0) {
+				--m_empty;
+			}
+			if (m_selected[i]) {
+				--m_selected_count;
+			}
+			m_garbage += std::strlen(source(i)) + ipath_size + 2;
+			m_ipath_bytes -= ipath_size;
+			m_estimated_bytes -= padded(m_estimate[i].estimate());
+			m_estimated -= m_estimate[i].known();
+			removed.push_back(m_id[i]);
+			continue;
+		}
+
+		m_source[kept] = m_source[i];
+		m_name[kept] = m_name[i];
+		m_ipath[kept] = m_ipath[i];
+		m_selected[kept] = m_selected[i];
+		m_id[kept] = m_id[i];
+		m_estimate[kept] = m_estimate[i];
+		++kept;
+	}
+
+	m_source.resize(kept);
+	m_name.resize(kept);
+	m_ipath.resize(kept);
+	m_selected.resize(kept);
+	m_id.resize(kept);
+	m_estimate.resize(kept);
+	if (m_garbage > m_arena.size() / 2) {
+		compact();
+	}
+}
+
+void CreateList::remove(size_t i, std::vector<uint32_t>& removed) {
+	remove_rows(i, false, removed);
+}
+
+void CreateList::remove_selected(std::vector<uint32_t>& removed) {
+	if (!m_selected_count) {
+		return;
+	}
+
+	auto it = std::find(m_selected.begin(), m_selected.end(), 1);
+	remove_rows(it - m_selected.begin(), true, removed);
+}
+
+void CreateList::clear() {
+	m_arena.clear();
+	m_source.clear();
+	m_name.clear();
+	m_ipath.clear();
+	m_selected.clear();
+	m_id.clear();
+	m_estimate.clear();
+	m_estimated_bytes = 0;
+	m_ipath_bytes = 0;
+	m_estimated = 0;
+	m_empty = 0;
+	m_selected_count = 0;
+	m_garbage = 0;
+}
+
+}
@@ -19,31 +19,33 @@
 // SOFTWARE.
 
 #include "nspre-gui.hpp"
+#include <algorithm>
 
 namespace ns {
 
-bool CreateWindow::files_ready() {
-	if (!files.size()) {
-		return false;
-	}
-
-	for (auto& f : files) {
-		if (f.second.empty()) {
-			return false;
-		}
-	}
-
-	return true;
-}
-
 void CreateWindow::create_pre() {
+	NS_PROFILE_SCOPE("create_pre");
 	std::vector<nspre::Subfile> subfiles;
-	for (auto& f : files) {
-		subfiles.push_back({f.first, f.second});
+	subfiles.reserve(files.size());
+	for (size_t i = 0; i < files.size(); ++i) {
+		subfiles.push_back({files.source(i), files.ipath(i)});
 	}
 
+	// nspre::write compresses everything, storing entries needs our own writer
 	int err;
-	if ((err = nspre::write(subfiles, out_file))) {
+	PackStats stats;
+	// nspre::write runs on this thread, write_pre on the whole pool
+	OperationTimer timer("create", out_file, !pack_options.auto_store);
+	EstimatorPause pause;
+	if (pack_options.auto_store) {
+		err = write_pre(subfiles, out_file, pack_options, &stats);
+	}
+	else {
+		err = nspre::write(subfiles, out_file);
+	}
+	timer.finish(subfiles.size(), err == 0);
+
+	if (err) {
 		if (err == nspre::Error::FILE_OPEN_OUTPUT) {
 			global.error_modal_text.str("");
 			global.error_modal_text << "Can't create file \"" << out_file.string() << "\"";
@@ -59,16 +61,60 @@ void CreateWindow::create_pre() {
 	}
 
 	std::printf("%zu files written to file \"%s\"\n", subfiles.size(), out_file.c_str());
+	if (pack_options.auto_store) {
+		std::printf("%llu compressed, %llu stored, %llu bytes in, %llu bytes out\n",
+			(unsigned long long)stats.compressed, (unsigned long long)stats.stored, (unsigned long long)stats.bytes_in, (unsigned long long)stats.bytes_out);
+	}
 }
 
-void CreateWindow::drop_files(const PathList& path_list) {
-	for (const std::filesystem::path& p : path_list) {
-		files.push_back({p, std::string("\\levels\\placeholder\\") + p.filename().string()});
+// Inputs are the list as it is now, later edits need a new watch
+void CreateWindow::start_watch() {
+	std::vector<nspre::Subfile> subfiles;
+	subfiles.reserve(files.size());
+	for (size_t i = 0; i < files.size(); ++i) {
+		subfiles.push_back({files.source(i), files.ipath(i)});
 	}
+
+	if (!watcher.start(subfiles, out_file, pack_options)) {
+		global.error_modal_text.str("Can't watch input files");
+		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
+		ImGui::OpenPopup("Error");
+		return;
+	}
+
+	std::printf("Watching %zu files for \"%s\"\n", subfiles.size(), out_file.c_str());
+}
+
+// Dropped paths may be folders, they are sorted out on the scanner
+void CreateWindow::drop_files(const PathList& path_list) {
+	scanner.add(path_list);
 }
 
 void CreateWindow::drop_file(const std::filesystem::path& path) {
-	files.push_back({path, std::string("\\levels\\placeholder\\") + path.filename().string()});
+	add_file(path, PLACEHOLDER_PREFIX + path.filename().string());
+}
+
+void CreateWindow::add_file(const std::filesystem::path& path, const std::string& ipath) {
+	estimator.add(files.add(path, ipath), path);
+}
+
+void CreateWindow::drop_folder(const std::filesystem::path& path) {
+	scanner.add({path});
+}
+
+void CreateWindow::apply_selection(ImGuiMultiSelectIO* msio) {
+	for (auto& req : msio->Requests) {
+		if (req.Type == ImGuiSelectionRequestType_SetAll) {
+			files.select_all(req.Selected);
+		}
+		else if (req.Type == ImGuiSelectionRequestType_SetRange) {
+			int first = std::min(req.RangeFirstItem, req.RangeLastItem);
+			int last = std::max(req.RangeFirstItem, req.RangeLastItem);
+			for (int i = first; i <= last; ++i) {
+				files.select(i, req.Selected);
+			}
+		}
+	}
 }
 
 void CreateWindow::edit_popup() {
@@ -77,21 +123,21 @@ void CreateWindow::edit_popup() {
 	}
 
 	if (edit_init) {
-		std::strncpy(ipath_buffer, files[edit_index].second.c_str(), INPUTTEXT_BUFFER_SIZE);
+		std::strncpy(ipath_buffer, files.ipath(edit_index), INPUTTEXT_BUFFER_SIZE);
 		edit_init = false;
 	}
 
-	ImGui::Text("File: %s", files[edit_index].first.c_str());
+	ImGui::Text("File: %s", files.source(edit_index));
 	ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x);
 	if (ImGui::InputText("###ipath", ipath_buffer, INPUTTEXT_BUFFER_SIZE, ImGuiInputTextFlags_EnterReturnsTrue)) {
-		files[edit_index].second = ipath_buffer;
+		files.set_ipath(edit_index, ipath_buffer);
 		edit_init = true;
 		ImGui::CloseCurrentPopup();
 	}
 	ImGui::PopItemWidth();
 
 	if (ImGui::Button("OK")) {
-		files[edit_index].second = ipath_buffer;
+		files.set_ipath(edit_index, ipath_buffer);
 		edit_init = true;
 		ImGui::CloseCurrentPopup();
 	}
@@ -104,10 +150,29 @@ void CreateWindow::edit_popup() {
 
 void CreateWindow::show() {
 	if (do_create) {
-		create_pre();
+		if (watch_after_save) {
+			start_watch();
+		}
+		else {
+			create_pre();
+		}
 		do_create = false;
 	}
 
+	scanner.poll(scan_progress);
+	for (FileEntry& f : scan_progress.files) {
+		add_file(f.first, f.second);
+	}
+
+	// Rows removed since their sample was taken are simply not found
+	estimator.poll(estimates);
+	for (auto& update : estimates) {
+		int64_t row = files.find(update.first);
+		if (row >= 0) {
+			files.set_estimate(row, update.second);
+		}
+	}
+
 	ImGui::SetNextWindowSizeConstraints({400,400}, {global.io->DisplaySize.x - 24,global.io->DisplaySize.y - 24});
 	if (ImGui::BeginPopupModal("Save", 0, ImGuiWindowFlags_NoScrollbar)) {
 		fb_save.show("out.pre");
@@ -130,13 +195,30 @@ void CreateWindow::show() {
 	bool show_edit = false;
 	bool add_files = false;
 	bool show_about = false;
+	bool remove_selected = false;
+	WatchStatus watch_status = watcher.status();
 	if (ImGui::BeginMenuBar()) {
 		if (ImGui::BeginMenu("File")) {
 			if (ImGui::MenuItem("Add file(s)...")) {
 				add_files = true;
 			}
-			if (ImGui::MenuItem("Save pre...", 0, false, files_ready())) {
+			if (ImGui::MenuItem("Save pre...", 0, false, files.ready() && !scan_progress.scanning)) {
 				create_popup = true;
+				watch_after_save = false;
+			}
+			if (ImGui::MenuItem("Save and watch...", 0, false, files.ready() && !scan_progress.scanning)) {
+				create_popup = true;
+				watch_after_save = true;
+			}
+			if (ImGui::MenuItem("Stop watching", 0, false, watch_status.watching)) {
+				watcher.stop();
+			}
+			ImGui::MenuItem("Store incompressible files", 0, &pack_options.auto_store);
+			if (pack_options.auto_store) {
+				ImGui::SliderFloat("Store at ratio", &pack_options.store_ratio, 0.5f, 1.0f, "%.2f");
+				if (ImGui::IsItemHovered()) {
+					ImGui::SetTooltip("Files whose sampled entropy predicts they won't shrink below this fraction of their size are stored");
+				}
 			}
 
 			ImGui::Separator();
@@ -150,6 +232,26 @@ void CreateWindow::show() {
 					global.show_debug = true;
 				}
 			}
+			if (global.show_profiler) {
+				if (ImGui::MenuItem("Hide profiler")) {
+					global.show_profiler = false;
+				}
+			}
+			else {
+				if (ImGui::MenuItem("Show profiler")) {
+					global.show_profiler = true;
+				}
+			}
+			if (global.show_operations) {
+				if (ImGui::MenuItem("Hide operations")) {
+					global.show_operations = false;
+				}
+			}
+			else {
+				if (ImGui::MenuItem("Show operations")) {
+					global.show_operations = true;
+				}
+			}
 
 			ImGui::Separator();
 			if (ImGui::MenuItem("Quit")) {
@@ -186,67 +288,148 @@ void CreateWindow::show() {
 		ImGui::OpenPopup("About");
 	}
 
+	if (watch_status.watching) {
+		if (!watch_status.builds) {
+			ImGui::Text("Building %s...", out_file.filename().c_str());
+		}
+		else if (watch_status.error) {
+			ImGui::TextColored({255,0,0,255}, "Rebuilding %s failed, waiting for the next change", out_file.filename().c_str());
+		}
+		else {
+			ImGui::Text("Watching, %u builds of %s, last took %.0f ms (%llu packed, %llu reused)", watch_status.builds, out_file.filename().c_str(), watch_status.build_ms,
+				(unsigned long long)(watch_status.stats.compressed + watch_status.stats.stored), (unsigned long long)watch_status.stats.reused);
+		}
+	}
+
+	if (scan_progress.scanning) {
+		ImGui::Text("Scanning folders, %u files found", scan_progress.found);
+		ImGui::SameLine();
+		if (ImGui::SmallButton("Cancel")) {
+			scanner.cancel();
+		}
+	}
+
 	if (files.size()) {
-		if (ImGui::BeginTable("files_to_add", 3, ImGuiTableFlags_Borders)) {
+		char projected[32];
+		format_size(projected, sizeof(projected), files.projected_size());
+		ImGui::Text("%zu files, about %s packed", files.size(), projected);
+		if (files.estimated_count() < files.size()) {
+			ImGui::SameLine();
+			ImGui::TextDisabled("(%zu of %zu sampled)", files.estimated_count(), files.size());
+		}
+		if (files.selected_count()) {
+			ImGui::SameLine();
+			ImGui::Text("(%zu selected)", files.selected_count());
+			ImGui::SameLine();
+			if (ImGui::SmallButton("Remove selected")) {
+				remove_selected = true;
+			}
+		}
+
+		if (ImGui::BeginTable("files_to_add", 4, ImGuiTableFlags_Borders)) {
 			ImGui::TableSetupColumn(" ", ImGuiTableColumnFlags_WidthFixed);
 			ImGui::TableSetupColumn("File", ImGuiTableColumnFlags_WidthFixed);
+			ImGui::TableSetupColumn("Packed", ImGuiTableColumnFlags_WidthFixed);
 			ImGui::TableSetupColumn("Internal Path");
 			ImGui::TableHeadersRow();
 
 			bool delete_element = false;
 			int element_to_delete = 0;
 
-			for (int i = 0; i < files.size(); ++i) {
-				ImGui::TableNextColumn();
-				ImGui::PushID(i);
-				if (ImGui::Button("-")) {
-					delete_element = true;
-					element_to_delete = i;
-				}
-				if (ImGui::IsItemHovered(ImGuiHoveredFlags_Stationary)) {
-					ImGui::SetTooltip("Remove file");
-				}
-				ImGui::SameLine();
-				ImGui::TableNextColumn();
-				ImGui::Text("%s", files[i].first.filename().c_str());
-				if (ImGui::IsItemHovered()) {
-					ImGui::SetTooltip("%s", files[i].first.c_str());
-				}
+			int rows = files.size();
+			ImGuiMultiSelectIO* msio = ImGui::BeginMultiSelect(ImGuiMultiSelectFlags_ClearOnEscape | ImGuiMultiSelectFlags_BoxSelect1d, files.selected_count(), rows);
+			apply_selection(msio);
 
-				ImGui::TableNextColumn();
-				if (ImGui::Button("\"")) {
-					edit_index = i;
-					show_edit = true;
-				}
-				if (ImGui::IsItemHovered()) {
-					ImGui::SetTooltip("Edit internal path");
-				}
-				ImGui::PopID();
-				ImGui::SameLine();
-				ImGui::Dummy({0,0});
-				ImGui::SameLine();
-				if (files[i].second.empty()) {
-					ImGui::TextColored({255,0,0,255}, "(empty)");
-				}
-				else {
-					ImGui::Text("%s", files[i].second.c_str());
-				}
+			ImGuiListClipper clipper;
+			clipper.Begin(rows);
+			if (msio->RangeSrcItem != -1) {
+				clipper.IncludeItemByIndex((int)msio->RangeSrcItem);
+			}
+			while (clipper.Step()) {
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+					ImGui::TableNextColumn();
+					ImGui::PushID(i);
+					if (ImGui::Button("-")) {
+						delete_element = true;
+						element_to_delete = i;
+					}
+					if (ImGui::IsItemHovered(ImGuiHoveredFlags_Stationary)) {
+						ImGui::SetTooltip("Remove file");
+					}
+					ImGui::SameLine();
+					ImGui::TableNextColumn();
+					ImGui::SetNextItemSelectionUserData(i);
+					ImGui::Selectable(files.filename(i), files.selected(i), ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowOverlap);
+					if (ImGui::IsItemHovered(ImGuiHoveredFlags_Stationary)) {
+						ImGui::SetTooltip("%s", files.source(i));
+					}
 
-				if (ImGui::IsItemHovered()) {
-					ImGui::SetTooltip("Double click to edit internal path");
-					if (ImGui::IsMouseDoubleClicked(0)) {
+					// Estimates are prefixed with ~ until the whole file has been compressed
+					ImGui::TableNextColumn();
+					const SizeEstimate& estimate = files.estimate(i);
+					if (estimate.known()) {
+						char packed[32];
+						format_size(packed, sizeof(packed), estimate.estimate());
+						int percent = estimate.size ? (int)(100 * estimate.estimate() / estimate.size) : 100;
+						ImGui::Text("%s%s (%d%%)", estimate.exact ? "" : "~", packed, percent);
+					}
+					else {
+						ImGui::TextDisabled("...");
+					}
+
+					ImGui::TableNextColumn();
+					if (ImGui::Button("\"")) {
 						edit_index = i;
 						show_edit = true;
 					}
+					if (ImGui::IsItemHovered()) {
+						ImGui::SetTooltip("Edit internal path");
+					}
+					ImGui::PopID();
+					ImGui::SameLine();
+					ImGui::Dummy({0,0});
+					ImGui::SameLine();
+					const char* ipath = files.ipath(i);
+					if (!ipath[0]) {
+						ImGui::TextColored({255,0,0,255}, "(empty)");
+					}
+					else {
+						ImGui::Text("%s", ipath);
+					}
+
+					if (ImGui::IsItemHovered()) {
+						ImGui::SetTooltip("Double click to edit internal path");
+						if (ImGui::IsMouseDoubleClicked(0)) {
+							edit_index = i;
+							show_edit = true;
+						}
+					}
 				}
 			}
 
+			msio = ImGui::EndMultiSelect();
+			apply_selection(msio);
+
 			ImGui::EndTable();
 
 			if (delete_element) {
-				files.erase(files.begin() + element_to_delete);
+				files.remove(element_to_delete, removed_ids);
 			}
 		}
+
+		if (ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) && !ImGui::IsAnyItemActive() && ImGui::IsKeyPressed(ImGuiKey_Delete)) {
+			remove_selected = true;
+		}
+		if (remove_selected) {
+			files.remove_selected(removed_ids);
+		}
+		if (!files.size()) {
+			estimator.cancel();
+		}
+		else if (removed_ids.size()) {
+			estimator.remove(removed_ids);
+		}
+		removed_ids.clear();
 	}
 
 	if (show_edit && edit_index > -1) {
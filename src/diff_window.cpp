@@ -0,0 +1,214 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+void DiffWindow::set_paths(const std::filesystem::path& old_path, const std::filesystem::path& new_path) {
+	std::snprintf(old_buffer, sizeof(old_buffer), "%s", old_path.c_str());
+	std::snprintf(new_buffer, sizeof(new_buffer), "%s", new_path.c_str());
+}
+
+// Runs on the worker pool, a superseded job finishes and is dropped
+void DiffWindow::compare() {
+	job = std::make_shared<Job>();
+	job->diff.old_path = old_buffer;
+	job->diff.new_path = new_buffer;
+	status.clear();
+
+	std::shared_ptr<Job> j = job;
+	worker_pool.submit([j]() {
+		OperationTimer timer("diff", j->diff.new_path);
+		j->error = diff_archives(j->diff, &j->progress);
+		timer.finish(j->diff.added + j->diff.removed + j->diff.modified + j->diff.unchanged, j->error == 0);
+		j->done = true;
+		request_redraw();
+	});
+}
+
+void DiffWindow::poll() {
+	if (!job || !job->done) {
+		return;
+	}
+
+	std::shared_ptr<Job> j = std::move(job);
+	if (j->error) {
+		fs::path bad = (j->error == 1) ? j->diff.old_path : j->diff.new_path;
+		status = "Can't read entry table of \"" + bad.string() + "\"";
+		std::fprintf(stderr, "%s\n", status.c_str());
+		return;
+	}
+
+	diff = std::make_unique<ArchiveDiff>(std::move(j->diff));
+	filter();
+	std::printf("Compared \"%s\" with \"%s\": %u added, %u removed, %u modified\n",
+		diff->old_path.c_str(), diff->new_path.c_str(), diff->added, diff->removed, diff->modified);
+}
+
+void DiffWindow::filter() {
+	rows.clear();
+	if (!diff) {
+		return;
+	}
+
+	for (size_t i = 0; i < diff->entries.size(); ++i) {
+		if (show_unchanged || diff->entries[i].change != DIFF_UNCHANGED) {
+			rows.push_back(i);
+		}
+	}
+}
+
+void DiffWindow::int_export() {
+	if (!diff) {
+		return;
+	}
+
+	int err = write_diff(*diff, export_out, export_format, show_unchanged);
+	if (err == nspre::Error::FILE_OPEN_OUTPUT) {
+		status = "Can't create file \"" + export_out.string() + "\"";
+	}
+	else if (err) {
+		status = "Can't write to file \"" + export_out.string() + "\"";
+	}
+	else {
+		status = "Exported to \"" + export_out.string() + "\"";
+		std::printf("Diff written to \"%s\"\n", export_out.c_str());
+		return;
+	}
+
+	std::fprintf(stderr, "%s\n", status.c_str());
+}
+
+void DiffWindow::show(bool* open) {
+	if (!*open) {
+		return;
+	}
+
+	poll();
+
+	if (do_export) {
+		int_export();
+		do_export = false;
+	}
+
+	ImGui::SetNextWindowSize({800, 500}, ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Compare archives", open)) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::SetNextWindowSizeConstraints({400,400}, {global.io->DisplaySize.x - 24,global.io->DisplaySize.y - 24});
+	if (ImGui::BeginPopupModal("Export diff", 0, ImGuiWindowFlags_NoScrollbar)) {
+		ImGui::Text("Format");
+		ImGui::SameLine();
+		ImGui::RadioButton("csv", &export_format, MANIFEST_CSV);
+		ImGui::SameLine();
+		ImGui::RadioButton("JSON Lines", &export_format, MANIFEST_JSONL);
+
+		fb_export.show(fs::path(std::string("diff") + manifest_extension(export_format)));
+		ImGui::EndPopup();
+	}
+
+	ImGui::InputText("Old", old_buffer, INPUTTEXT_BUFFER_SIZE);
+	ImGui::InputText("New", new_buffer, INPUTTEXT_BUFFER_SIZE);
+
+	ImGui::BeginDisabled(job != nullptr || !old_buffer[0] || !new_buffer[0]);
+	if (ImGui::Button("Compare")) {
+		compare();
+	}
+	ImGui::EndDisabled();
+
+	ImGui::SameLine();
+	ImGui::BeginDisabled(!diff);
+	bool export_diff = ImGui::Button("Export...");
+	ImGui::EndDisabled();
+
+	ImGui::SameLine();
+	if (ImGui::Checkbox("Show unchanged", &show_unchanged)) {
+		filter();
+	}
+
+	if (job) {
+		uint32_t done = job->progress.done;
+		uint32_t total = job->progress.total;
+		char overlay[64];
+		std::snprintf(overlay, sizeof(overlay), "%u / %u entries compared", done, total);
+		ImGui::ProgressBar(total ? (float)done / total : 0.0f, {ImGui::GetContentRegionAvail().x - 80, 0}, overlay);
+		ImGui::SameLine();
+		if (ImGui::Button("Cancel")) {
+			job.reset();
+		}
+	}
+	else if (diff) {
+		ImGui::Text("%u added, %u removed, %u modified, %u unchanged (%u skipped on identical bytes, %u decompressed)",
+			diff->added, diff->removed, diff->modified, diff->unchanged, diff->skipped, diff->decompressed);
+	}
+
+	if (status.size()) {
+		ImGui::TextWrapped("%s", status.c_str());
+	}
+
+	if (diff && rows.size() && ImGui::BeginTable("diff_table", 6, ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Change", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableSetupColumn("Path");
+		ImGui::TableSetupColumn("Old Size", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableSetupColumn("New Size", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableSetupColumn("Old Compressed", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableSetupColumn("New Compressed", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableHeadersRow();
+
+		ImGuiListClipper clipper;
+		clipper.Begin(rows.size());
+		while (clipper.Step()) {
+			for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+				const DiffEntry& d = diff->entries[rows[i]];
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", diff_change_name(d.change));
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", d.prepath.c_str());
+				ImGui::TableNextColumn();
+				if (d.change != DIFF_ADDED) ImGui::Text("%u", d.old_size);
+				ImGui::TableNextColumn();
+				if (d.change != DIFF_REMOVED) ImGui::Text("%u", d.new_size);
+				ImGui::TableNextColumn();
+				if (d.change != DIFF_ADDED) ImGui::Text("%u", d.old_cmp_size);
+				ImGui::TableNextColumn();
+				if (d.change != DIFF_REMOVED) ImGui::Text("%u", d.new_cmp_size);
+			}
+		}
+
+		ImGui::EndTable();
+	}
+
+	if (export_diff) ImGui::OpenPopup("Export diff");
+
+	ImGui::End();
+}
+
+DiffWindow::DiffWindow() : fb_export(export_out, do_export) {
+
+}
+
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <ctime>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+// Results are handed over in batches so the UI thread isn't fighting for the
+// lock on every entry
+static const size_t STAT_BATCH_SIZE = 256;
+
+void DirStatter::run() {
+	std::vector<StatResult> batch;
+	batch.reserve(STAT_BATCH_SIZE);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_quit) {
+		if (!m_pending) {
+			m_cv.wait(lock);
+			continue;
+		}
+
+		m_pending = false;
+		unsigned generation = m_generation;
+		fs::path dir = m_dir;
+		std::vector<std::string> names = std::move(m_names);
+		lock.unlock();
+
+		NS_PROFILE_SCOPE("stat_dir");
+		int dirfd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		for (size_t i = 0; i < names.size() && dirfd >= 0; ++i) {
+			struct statx stx;
+			if (statx(dirfd, names[i].c_str(), AT_STATX_DONT_SYNC, STATX_SIZE | STATX_MTIME, &stx) == 0) {
+				StatResult r;
+				r.index = i;
+				r.size = stx.stx_size;
+				r.mtime = (int64_t)stx.stx_mtime.tv_sec * 1000000000 + stx.stx_mtime.tv_nsec;
+
+				time_t t = stx.stx_mtime.tv_sec;
+				struct tm tm;
+				localtime_r(&t, &tm);
+				std::strftime(r.mtime_text, sizeof(r.mtime_text), "%Y-%m-%d %H:%M", &tm);
+				batch.push_back(r);
+			}
+
+			if (batch.size() == STAT_BATCH_SIZE || i + 1 == names.size()) {
+				std::lock_guard<std::mutex> guard(m_mutex);
+				if (generation != m_generation) {
+					batch.clear();
+					break;
+				}
+
+				m_results.insert(m_results.end(), batch.begin(), batch.end());
+				batch.clear();
+				request_redraw();
+			}
+		}
+
+		if (dirfd >= 0) {
+			close(dirfd);
+		}
+
+		lock.lock();
+	}
+}
+
+void DirStatter::request(const std::filesystem::path& dir, std::vector<std::string> names) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_dir = dir;
+		m_names = std::move(names);
+		m_pending = true;
+		m_results.clear();
+		++m_generation;
+	}
+
+	if (!m_worker.joinable()) {
+		m_worker = std::thread(&DirStatter::run, this);
+	}
+
+	m_cv.notify_one();
+}
+
+void DirStatter::poll(std::vector<StatResult>& out) {
+	out.clear();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	out.swap(m_results);
+}
+
+DirStatter::~DirStatter() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+
+	m_cv.notify_one();
+	if (m_worker.joinable()) {
+		m_worker.join();
+	}
+}
+
+}
@@ -19,81 +19,219 @@
 // SOFTWARE.
 
 #include "nspre-gui.hpp"
+#include <algorithm>
 
 namespace fs = std::filesystem;
 
 namespace ns {
 
+ArchiveTab* ExtractWindow::active() {
+	if (active_tab < 0 || active_tab >= (int)tabs.size()) {
+		return nullptr;
+	}
+
+	return tabs[active_tab].get();
+}
+
 bool ExtractWindow::pre_is_open() {
-	return pre_reader.error() == 0;
+	ArchiveTab* tab = active();
+	return tab && tab->reader && tab->reader->error() == 0;
+}
+
+void ExtractWindow::close_tab(size_t index) {
+	ArchiveTab& tab = *tabs[index];
+	tab.loader.cancel();
+	if (tab.reader) {
+		tab.reader->close();
+	}
+
+	tabs.erase(tabs.begin() + index);
+
+	// The tab bar picks the active tab again on the next frame
+	active_tab = -1;
+	if (select_tab == (int)index) {
+		select_tab = -1;
+	}
+	else if (select_tab > (int)index) {
+		--select_tab;
+	}
 }
 
 void ExtractWindow::close_pre() {
-	pre_reader.close();
+	if (active()) {
+		close_tab(active_tab);
+	}
+}
+
+void ExtractWindow::close_all() {
+	while (tabs.size()) {
+		close_tab(tabs.size() - 1);
+	}
 }
 
-void ExtractWindow::open_pre(const std::filesystem::path& path) {
-	in_file = path;
-	do_open = true;
+// focus names an entry to scroll to once the archive is open
+void ExtractWindow::open_pre(const std::filesystem::path& path, const std::string& focus) {
+	open_queue.push_back({path, focus});
 }
 
-void ExtractWindow::int_export_csv() {
-	std::ofstream stream(csv_out);
-	if (stream.fail()) {
+void ExtractWindow::int_export_manifest() {
+	ArchiveTab* tab = active();
+	if (!pre_is_open()) {
+		global.error_modal_text.str("No file open");
+		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
+		ImGui::OpenPopup("Error");
+		return;
+	}
+
+	NS_PROFILE_SCOPE("export_manifest");
+	OperationTimer timer("manifest", manifest_out, true);
+	int err = write_manifest(*tab->reader, tab->path, manifest_out, manifest_options);
+	timer.finish(tab->reader->files().size(), err == 0);
+	if (err == nspre::Error::FILE_OPEN_OUTPUT) {
 		global.error_modal_text.str("Can't create file \"");
-		global.error_modal_text << csv_out.string() << "\"";
+		global.error_modal_text << manifest_out.string() << "\"";
+	}
+	else if (err == nspre::Error::FILE_OPEN) {
+		global.error_modal_text.str("Can't read entry table of \"");
+		global.error_modal_text << tab->path.string() << "\"";
+	}
+	else if (err) {
+		global.error_modal_text.str("Can't write to file \"");
+		global.error_modal_text << manifest_out.string() << "\"";
+	}
+
+	if (err) {
 		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
+		ImGui::OpenPopup("Error");
 		return;
 	}
 
-	for (int i = 0; i < pre_reader.files().size(); ++i) {
-		stream << std::string(pre_reader.files()[i].filename().data()) << ",";
-		stream << pre_reader.files()[i].cmp_size() << ",";
-		stream << pre_reader.files()[i].size() << ",";
-		stream << std::string(pre_reader.files()[i].prepath().data()) << ",";
-		if (i + 1 < pre_reader.files().size()) {
-			stream << std::endl;
-		}
-		if (stream.fail()) {
-			global.error_modal_text.str("Can't write to file \"");
-			global.error_modal_text << csv_out.string() << "\"";
-			std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
+	std::printf("Manifest of %zu files written to \"%s\"\n", tab->reader->files().size(), manifest_out.c_str());
+}
+
+void ExtractWindow::export_manifest(const std::filesystem::path& path) {
+	manifest_out = path;
+	do_manifest = true;
+}
+
+void ExtractWindow::int_open_pre(const std::filesystem::path& path, const std::string& focus) {
+	// An archive that's already open just gets its tab brought forward
+	std::error_code ec;
+	for (size_t i = 0; i < tabs.size(); ++i) {
+		if (tabs[i]->path == path || fs::equivalent(tabs[i]->path, path, ec)) {
+			select_tab = i;
+			if (focus.size()) {
+				tabs[i]->focus = focus;
+			}
 			return;
 		}
 	}
-}
 
-void ExtractWindow::export_csv(const std::filesystem::path& path) {
-	csv_out = path;
-	do_csv = true;
+	auto tab = std::make_unique<ArchiveTab>();
+	tab->path = path;
+	tab->id = next_tab_id++;
+	tab->focus = focus;
+	tab->loading = true;
+	tab->last_active = ImGui::GetFrameCount();
+	tab->loader.open(path);
+	select_tab = tabs.size();
+	tabs.push_back(std::move(tab));
 }
 
-void ExtractWindow::int_open_pre() {
-	if (pre_reader.error() == 0 && in_file == old_in_file) {
-		global.error_modal_text.str("");
-		global.error_modal_text << "File \"" << old_in_file.c_str() << "\" is already open";
-		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
-		ImGui::OpenPopup("Error");
-		return;
+// Returns false if the tab failed to open and should be closed
+bool ExtractWindow::poll_tab(ArchiveTab& tab) {
+	tab.loader.poll(load_progress);
+	tab.entries.insert(tab.entries.end(), load_progress.entries.begin(), load_progress.entries.end());
+	if (!tab.evicted) {
+		tab.total = load_progress.total;
 	}
 
-	old_in_file = in_file;
-	int err = pre_reader.open(in_file);
+	if (!load_progress.done) {
+		return true;
+	}
+
+	tab.loading = false;
+
+	int err = load_progress.error;
 	if (err) {
-		pre_reader.close();
 		global.error_modal_text.str("");
 		if (err == nspre::Error::FILE_OPEN) {
-			global.error_modal_text << "Can't open file \"" << std::string(in_file) << "\"";
+			global.error_modal_text << "Can't open file \"" << std::string(tab.path) << "\"";
 		}
 		else {
-			global.error_modal_text << "File \"" << std::string(in_file) << "\" is corrupted or not a pre/prx file";
+			global.error_modal_text << "File \"" << std::string(tab.path) << "\" is corrupted or not a pre/prx file";
 		}
 		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
 		ImGui::OpenPopup("Error");
-		return;
+		return false;
+	}
+
+	// Readers are charged at the size of their archive
+	std::error_code ec;
+	tab.reader = std::move(load_progress.reader);
+	tab.reader_bytes = fs::file_size(tab.path, ec);
+	if (ec) {
+		tab.reader_bytes = 0;
+	}
+
+	if (tab.evicted) {
+		tab.evicted = false;
+		std::printf("File \"%s\" reopened\n", tab.path.c_str());
+		return true;
+	}
+
+	// nspre has the final say if the entry table couldn't be parsed
+	auto& files = tab.reader->files();
+	if (tab.entries.size() != files.size()) {
+		tab.entries.clear();
+		tab.entries.reserve(files.size());
+		for (auto& file : files) {
+			PreLayoutEntry e;
+			e.prepath = file.prepath();
+			e.size = file.size();
+			e.cmp_size = file.cmp_size();
+			tab.entries.push_back(std::move(e));
+		}
+	}
+
+	tab.entries.shrink_to_fit();
+	tab.total = tab.entries.size();
+	std::printf("File \"%s\" opened, containing %zu files\n", tab.path.c_str(), files.size());
+	return true;
+}
+
+// Drops the readers of inactive tabs, least recently shown first, until the
+// rest fit in the budget. Their entry tables stay so the tabs still draw.
+void ExtractWindow::enforce_budget() {
+	uint64_t used = 0;
+	for (auto& tab : tabs) {
+		if (tab->reader) {
+			used += tab->reader_bytes;
+		}
 	}
 
-	std::printf("File \"%s\" opened, containing %zu files\n", in_file.c_str(), pre_reader.files().size());
+	while (used > global.memory_budget) {
+		ArchiveTab* victim = nullptr;
+		for (size_t i = 0; i < tabs.size(); ++i) {
+			ArchiveTab* tab = tabs[i].get();
+			if ((int)i == active_tab || !tab->reader) {
+				continue;
+			}
+			if (!victim || tab->last_active < victim->last_active) {
+				victim = tab;
+			}
+		}
+
+		if (!victim) {
+			break;
+		}
+
+		victim->reader->close();
+		victim->reader.reset();
+		victim->evicted = true;
+		used -= victim->reader_bytes;
+		std::printf("Reader for \"%s\" evicted, %llu MiB in use\n", victim->path.c_str(), (unsigned long long)(used >> 20));
+	}
 }
 
 void ExtractWindow::extract_pre(const std::filesystem::path& path) {
@@ -102,43 +240,285 @@ void ExtractWindow::extract_pre(const std::filesystem::path& path) {
 }
 
 void ExtractWindow::extract_files() {
-	if ((pre_reader.error() != 0) || pre_reader.files().size() == 0) {
+	ArchiveTab* tab = active();
+	if (!pre_is_open() || tab->reader->files().size() == 0) {
 		global.error_modal_text.str("No file open");
 		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
 		ImGui::OpenPopup("Error");
 		return;
 	}
 
-	int err;
-	for (int i = 0; i < pre_reader.files().size(); ++i) {
-		if ((err = pre_reader.files()[i].extract(out_dir / pre_reader.files()[i].filename()))) {
-			if (err == nspre::Error::FILE_OPEN_OUTPUT) {
-				global.error_modal_text.str("Can't create file \"");
-				global.error_modal_text << std::string(out_dir / pre_reader.files()[i].filename()) << "\"";
+	NS_PROFILE_SCOPE("extract_files");
+	// io_uring writes may be finished by kernel workers, which only show up
+	// in the process counters
+	OperationTimer timer("extract", tab->path, global.uring_depth == 0);
+	auto& files = tab->reader->files();
+	Extractor extractor(*tab->reader, tab->path);
+	if (global.uring_depth) {
+		extractor.use_uring(global.uring_depth);
+	}
+	extractor.use_dedup(link_duplicates);
+	extractor.use_direct_io(global.direct_io_min);
+	extractor.use_prefetch(worker_pool.threads() * PREFETCH_PER_WORKER);
+
+	int err = 0;
+	std::vector<uint32_t> order = extractor.offset_order();
+	for (size_t k = 0; k < order.size() && !err; ++k) {
+		extractor.prefetch(order, k);
+		err = extractor.extract(order[k], out_dir / files[order[k]].filename());
+	}
+	if (!err) {
+		err = extractor.finish();
+	}
+	timer.finish(files.size(), err == 0);
+
+	if (err) {
+		if (err == nspre::Error::FILE_OPEN_OUTPUT) {
+			global.error_modal_text.str("Can't create file \"");
+			global.error_modal_text << extractor.failed_path().string() << "\"";
+		}
+		else {
+			global.error_modal_text.str("Error extracting file \"");
+			global.error_modal_text << extractor.failed_path().filename().string() << "\"";
+		}
+
+		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
+		ImGui::OpenPopup("Error");
+		return;
+	}
+
+	const ExtractStats& stats = extractor.stats();
+	std::printf("%zu files extracted from file \"%s\" to location \"%s\" (%llu copied directly, %llu reflinked, %llu batched)\n",
+		files.size(), tab->path.c_str(), out_dir.c_str(), (unsigned long long)stats.stored, (unsigned long long)stats.cloned, (unsigned long long)stats.batched);
+	if (link_duplicates) {
+		std::printf("%llu duplicates linked, %llu bytes not written\n", (unsigned long long)stats.linked, (unsigned long long)stats.linked_bytes);
+	}
+	if (stats.direct_io) {
+		std::printf("%llu files written with O_DIRECT\n", (unsigned long long)stats.direct_io);
+	}
+}
+
+// Runs on all cores but blocks the window, like the other operations on the
+// open archive
+void ExtractWindow::int_optimize() {
+	ArchiveTab* tab = active();
+	if (!pre_is_open()) {
+		global.error_modal_text.str("No file open");
+		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
+		ImGui::OpenPopup("Error");
+		return;
+	}
+
+	OptimizeStats stats;
+	OperationTimer timer("optimize", tab->path);
+	int err = optimize_pre(tab->path, optimize_out, stats);
+	timer.finish(stats.entries, err == 0);
+	if (err == nspre::Error::FILE_OPEN_OUTPUT) {
+		global.error_modal_text.str("Can't create file \"");
+		global.error_modal_text << optimize_out.string() << "\"";
+	}
+	else if (err == nspre::Error::FILE_OPEN) {
+		global.error_modal_text.str("Error reading file \"");
+		global.error_modal_text << tab->path.string() << "\"";
+	}
+	else if (err) {
+		global.error_modal_text.str("Can't write to file \"");
+		global.error_modal_text << optimize_out.string() << "\"";
+	}
+
+	if (err) {
+		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
+		ImGui::OpenPopup("Error");
+		return;
+	}
+
+	char before[32];
+	char after[32];
+	char saved[32];
+	format_size(before, sizeof(before), stats.bytes_before);
+	format_size(after, sizeof(after), stats.bytes_after);
+	format_size(saved, sizeof(saved), stats.bytes_before - stats.bytes_after);
+
+	std::stringstream report;
+	report << stats.improved << " of " << stats.entries << " entries recompressed smaller\n"
+		<< before << " -> " << after << ", " << saved << " saved in " << (int)stats.ms << " ms";
+	optimize_report = report.str();
+	std::printf("Optimized \"%s\" to \"%s\": %s\n", tab->path.c_str(), optimize_out.c_str(), optimize_report.c_str());
+	ImGui::OpenPopup("Optimized");
+}
+
+static void apply_selection(ImGuiMultiSelectIO* msio, ArchiveTab& tab) {
+	for (auto& req : msio->Requests) {
+		if (req.Type == ImGuiSelectionRequestType_SetAll) {
+			std::fill(tab.selected.begin(), tab.selected.end(), req.Selected);
+		}
+		else if (req.Type == ImGuiSelectionRequestType_SetRange) {
+			int first = std::min(req.RangeFirstItem, req.RangeLastItem);
+			int last = std::max(req.RangeFirstItem, req.RangeLastItem);
+			for (int i = first; i <= last; ++i) {
+				tab.selected[i] = req.Selected;
 			}
-			else {
-				global.error_modal_text.str("Error extracting file \"");
-				global.error_modal_text << pre_reader.files()[i].filename() << "\"";
+		}
+	}
+}
+
+// Selected entries only, if there are any
+void ExtractWindow::int_extract_tar() {
+	ArchiveTab* tab = active();
+	if (!pre_is_open()) {
+		global.error_modal_text.str("No file open");
+		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
+		ImGui::OpenPopup("Error");
+		return;
+	}
+
+	NS_PROFILE_SCOPE("extract_tar");
+	std::vector<uint32_t> subset;
+	for (size_t i = 0; i < tab->selected.size(); ++i) {
+		if (tab->selected[i]) {
+			subset.push_back(i);
+		}
+	}
+
+	std::string failed;
+	OperationTimer timer("tar", tab->path);
+	int err = write_tar(*tab->reader, tab->path, tar_out, subset.size() ? &subset : nullptr, &failed);
+	timer.finish(subset.size() ? subset.size() : tab->reader->files().size(), err == 0);
+	if (err == nspre::Error::FILE_OPEN_OUTPUT) {
+		global.error_modal_text.str("Can't create file \"");
+		global.error_modal_text << tar_out.string() << "\"";
+	}
+	else if (err == nspre::Error::FILE_OPEN) {
+		global.error_modal_text.str("Error extracting file \"");
+		global.error_modal_text << failed << "\"";
+	}
+	else if (err) {
+		global.error_modal_text.str("Can't write to file \"");
+		global.error_modal_text << tar_out.string() << "\"";
+	}
+
+	if (err) {
+		std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
+		ImGui::OpenPopup("Error");
+		return;
+	}
+
+	std::printf("%zu files from file \"%s\" written to \"%s\"\n", subset.size() ? subset.size() : tab->reader->files().size(), tab->path.c_str(), tar_out.c_str());
+}
+
+// Returns false if the tab should be closed
+bool ExtractWindow::show_tab(ArchiveTab& tab) {
+	// Shown again after its reader was evicted, the table is drawn from the
+	// resident entries until the reader is back
+	if (tab.evicted && !tab.loading) {
+		tab.loading = true;
+		tab.loader.open(tab.path, false);
+	}
+
+	if (tab.loading && !tab.evicted) {
+		ImGui::Text("Opening %s", tab.path.c_str());
+		char overlay[64];
+		std::snprintf(overlay, sizeof(overlay), "%zu / %u entries", tab.entries.size(), tab.total);
+		ImGui::ProgressBar(tab.total ? (float)tab.entries.size() / tab.total : 0.0f, {ImGui::GetContentRegionAvail().x - 80, 0}, overlay);
+		ImGui::SameLine();
+		if (ImGui::Button("Cancel")) {
+			std::printf("Opening file \"%s\" cancelled\n", tab.path.c_str());
+			return false;
+		}
+	}
+	else if (tab.loading) {
+		ImGui::Text("%s (reopening)", tab.path.c_str());
+	}
+	else {
+		ImGui::Text("%s", tab.path.c_str());
+	}
+
+	if (!tab.loading && tab.focus.size()) {
+		for (size_t i = 0; i < tab.entries.size(); ++i) {
+			if (tab.entries[i].prepath == tab.focus) {
+				tab.focus_row = i;
+				tab.scroll_to_focus = true;
+				break;
 			}
+		}
+		tab.focus.clear();
+	}
 
-			std::fprintf(stderr, "%s\n", global.error_modal_text.str().c_str());
-			ImGui::OpenPopup("Error");
-			return;
+	int rows = tab.entries.size();
+	tab.selected.resize(rows);
+	if (rows) {
+		if (ImGui::BeginTable("extract_table", 4, ImGuiTableFlags_Borders)) {
+			ImGui::TableSetupColumn("File", ImGuiTableColumnFlags_WidthFixed);
+			ImGui::TableSetupColumn("Compressed Size", ImGuiTableColumnFlags_WidthFixed);
+			ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed);
+			ImGui::TableSetupColumn("Path");
+			ImGui::TableHeadersRow();
+
+			ImGuiMultiSelectIO* msio = ImGui::BeginMultiSelect(ImGuiMultiSelectFlags_ClearOnEscape | ImGuiMultiSelectFlags_BoxSelect1d, -1, rows);
+			apply_selection(msio, tab);
+
+			ImGuiListClipper clipper;
+			clipper.Begin(rows);
+			if (tab.scroll_to_focus) {
+				clipper.IncludeItemByIndex(tab.focus_row);
+			}
+			if (msio->RangeSrcItem != -1) {
+				clipper.IncludeItemByIndex((int)msio->RangeSrcItem);
+			}
+			while (clipper.Step()) {
+				for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+					const PreLayoutEntry& e = tab.entries[i];
+					size_t slash = e.prepath.find_last_of("\\/");
+					ImGui::TableNextColumn();
+					if (i == tab.focus_row) {
+						ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, ImGui::GetColorU32(ImGuiCol_TextSelectedBg));
+						if (tab.scroll_to_focus) {
+							ImGui::SetScrollHereY();
+							tab.scroll_to_focus = false;
+						}
+					}
+					ImGui::PushID(i);
+					ImGui::SetNextItemSelectionUserData(i);
+					ImGui::Selectable(slash == std::string::npos ? e.prepath.c_str() : e.prepath.c_str() + slash + 1, tab.selected[i] != 0, ImGuiSelectableFlags_SpanAllColumns);
+					ImGui::PopID();
+					ImGui::TableNextColumn();
+					ImGui::Text("%u", e.cmp_size);
+					ImGui::TableNextColumn();
+					ImGui::Text("%u", e.size);
+					ImGui::TableNextColumn();
+					ImGui::Text("%s", e.prepath.c_str());
+				}
+			}
+
+			msio = ImGui::EndMultiSelect();
+			apply_selection(msio, tab);
+
+			ImGui::EndTable();
 		}
 	}
 
-	std::printf("%zu files extracted from file \"%s\" to location \"%s\"\n", pre_reader.files().size(), in_file.c_str(), out_dir.c_str());
+	return true;
 }
 
 void ExtractWindow::show() {
-	if (do_open) {
-		int_open_pre();
-		do_open = false;
+	for (auto& request : open_queue) {
+		int_open_pre(request.first, request.second);
+	}
+	open_queue.clear();
+
+	for (size_t i = 0; i < tabs.size();) {
+		if (tabs[i]->loading && !poll_tab(*tabs[i])) {
+			close_tab(i);
+			continue;
+		}
+		++i;
 	}
 
-	if (do_csv) {
-		int_export_csv();
-		do_csv = false;
+	enforce_budget();
+
+	if (do_manifest) {
+		int_export_manifest();
+		do_manifest = false;
 	}
 
 	if (do_extract) {
@@ -146,6 +526,16 @@ void ExtractWindow::show() {
 		do_extract = false;
 	}
 
+	if (do_tar) {
+		int_extract_tar();
+		do_tar = false;
+	}
+
+	if (do_optimize) {
+		int_optimize();
+		do_optimize = false;
+	}
+
 	ImGui::SetNextWindowSizeConstraints({400,400}, {global.io->DisplaySize.x - 24,global.io->DisplaySize.y - 24});
 	if (ImGui::BeginPopupModal("Open", 0, ImGuiWindowFlags_NoScrollbar)) {
 		fb_open.show();
@@ -159,14 +549,55 @@ void ExtractWindow::show() {
 	}
 
 	ImGui::SetNextWindowSizeConstraints({400,400}, {global.io->DisplaySize.x - 24,global.io->DisplaySize.y - 24});
-	if (ImGui::BeginPopupModal("Export csv", 0, ImGuiWindowFlags_NoScrollbar)) {
-		fb_saveone.show(fs::path(in_file.filename().string() + ".csv"));
+	if (ImGui::BeginPopupModal("Export manifest", 0, ImGuiWindowFlags_NoScrollbar)) {
+		ImGui::Text("Format");
+		ImGui::SameLine();
+		ImGui::RadioButton("csv", &manifest_options.format, MANIFEST_CSV);
+		ImGui::SameLine();
+		ImGui::RadioButton("JSON Lines", &manifest_options.format, MANIFEST_JSONL);
+		ImGui::SameLine();
+		ImGui::RadioButton("binary", &manifest_options.format, MANIFEST_BINARY);
+
+		ImGui::Text("Columns");
+		ImGui::SameLine();
+		ImGui::CheckboxFlags("offset", &manifest_options.columns, MANIFEST_OFFSET);
+		ImGui::SameLine();
+		ImGui::CheckboxFlags("ratio", &manifest_options.columns, MANIFEST_RATIO);
+		ImGui::SameLine();
+		ImGui::CheckboxFlags("hash", &manifest_options.columns, MANIFEST_HASH);
+
+		fs::path archive = active() ? active()->path.filename() : fs::path("manifest");
+		fb_saveone.show(fs::path(archive.string() + manifest_extension(manifest_options.format)));
+		ImGui::EndPopup();
+	}
+
+	ImGui::SetNextWindowSizeConstraints({400,400}, {global.io->DisplaySize.x - 24,global.io->DisplaySize.y - 24});
+	if (ImGui::BeginPopupModal("Extract to tar", 0, ImGuiWindowFlags_NoScrollbar)) {
+		fs::path archive = active() ? active()->path.stem() : fs::path("archive");
+		fb_savetar.show(fs::path(archive.string() + ".tar"));
+		ImGui::EndPopup();
+	}
+
+	ImGui::SetNextWindowSizeConstraints({400,400}, {global.io->DisplaySize.x - 24,global.io->DisplaySize.y - 24});
+	if (ImGui::BeginPopupModal("Optimize archive", 0, ImGuiWindowFlags_NoScrollbar)) {
+		fs::path archive = active() ? active()->path : fs::path("archive.pre");
+		fb_optimize.show(fs::path(archive.stem().string() + "-optimized" + archive.extension().string()));
+		ImGui::EndPopup();
+	}
+
+	if (ImGui::BeginPopupModal("Optimized", 0, ImGuiWindowFlags_AlwaysAutoResize)) {
+		ImGui::Text("%s", optimize_report.c_str());
+		if (ImGui::Button("OK")) {
+			ImGui::CloseCurrentPopup();
+		}
 		ImGui::EndPopup();
 	}
 
 	bool open_file = false;
 	bool select_dir = false;
-	bool export_csv = false;
+	bool export_manifest = false;
+	bool extract_tar = false;
+	bool optimize = false;
 	bool show_about = false;
 
 	if (ImGui::BeginMenuBar()) {
@@ -177,12 +608,39 @@ void ExtractWindow::show() {
 			if (ImGui::MenuItem("Extract...", 0, false, extract_window.pre_is_open())) {
 				select_dir = true;
 			}
-			if (ImGui::MenuItem("Export csv...", 0, false, extract_window.pre_is_open())) {
-				export_csv = true;
+			ImGui::MenuItem("Link duplicate files on extract", 0, &link_duplicates);
+			ArchiveTab* tab = active();
+			bool any_selected = tab && std::find(tab->selected.begin(), tab->selected.end(), 1) != tab->selected.end();
+			if (ImGui::MenuItem(any_selected ? "Extract selected to tar..." : "Extract to tar...", 0, false, extract_window.pre_is_open())) {
+				extract_tar = true;
+			}
+			if (ImGui::MenuItem("Export manifest...", 0, false, extract_window.pre_is_open())) {
+				export_manifest = true;
 			}
-			if (ImGui::MenuItem("Close", 0, false, extract_window.pre_is_open())) {
+			if (ImGui::MenuItem("Optimize archive...", 0, false, extract_window.pre_is_open())) {
+				optimize = true;
+			}
+			if (ImGui::MenuItem("Find in archives...")) {
+				global.show_index = true;
+			}
+			if (ImGui::MenuItem("Compare archives...")) {
+				// Starts from the two most recently shown tabs
+				ArchiveTab* a = active();
+				ArchiveTab* b = nullptr;
+				for (auto& tab : tabs) {
+					if (tab.get() != a && (!b || tab->last_active > b->last_active)) {
+						b = tab.get();
+					}
+				}
+				diff_window.set_paths(b ? b->path : fs::path(), a ? a->path : fs::path());
+				global.show_diff = true;
+			}
+			if (ImGui::MenuItem("Close", 0, false, active() != nullptr)) {
 				extract_window.close_pre();
 			}
+			if (ImGui::MenuItem("Close all", 0, false, tabs.size() > 0)) {
+				extract_window.close_all();
+			}
 			ImGui::Separator();
 
 			if (global.show_debug) {
@@ -195,6 +653,26 @@ void ExtractWindow::show() {
 					global.show_debug = true;
 				}
 			}
+			if (global.show_profiler) {
+				if (ImGui::MenuItem("Hide profiler")) {
+					global.show_profiler = false;
+				}
+			}
+			else {
+				if (ImGui::MenuItem("Show profiler")) {
+					global.show_profiler = true;
+				}
+			}
+			if (global.show_operations) {
+				if (ImGui::MenuItem("Hide operations")) {
+					global.show_operations = false;
+				}
+			}
+			else {
+				if (ImGui::MenuItem("Show operations")) {
+					global.show_operations = true;
+				}
+			}
 			ImGui::Separator();
 
 			if (ImGui::MenuItem("Quit")) {
@@ -228,43 +706,53 @@ void ExtractWindow::show() {
 		ImGui::OpenPopup("About");
 	}
 
-	if (pre_is_open()) {
-		ImGui::Text("%s", in_file.c_str());
-	}
-	else {
+	if (tabs.empty()) {
 		if (ImGui::Button("Open pre/prx...")) {
 			open_file = true;
 		}
 	}
-	if (pre_reader.files().size()) {
-		if (ImGui::BeginTable("extract_table", 4, ImGuiTableFlags_Borders)) {
-			ImGui::TableSetupColumn("File", ImGuiTableColumnFlags_WidthFixed);
-			ImGui::TableSetupColumn("Compressed Size", ImGuiTableColumnFlags_WidthFixed);
-			ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed);
-			ImGui::TableSetupColumn("Path");
-			ImGui::TableHeadersRow();
+	else if (ImGui::BeginTabBar("archives", ImGuiTabBarFlags_AutoSelectNewTabs | ImGuiTabBarFlags_FittingPolicyScroll)) {
+		int close = -1;
+		active_tab = -1;
+		for (size_t i = 0; i < tabs.size(); ++i) {
+			ArchiveTab& tab = *tabs[i];
+			std::string label = tab.path.filename().string() + "###tab" + std::to_string(tab.id);
+			bool open = true;
+			ImGuiTabItemFlags flags = (select_tab == (int)i) ? ImGuiTabItemFlags_SetSelected : 0;
+			if (ImGui::BeginTabItem(label.c_str(), &open, flags)) {
+				active_tab = i;
+				tab.last_active = ImGui::GetFrameCount();
+				if (!show_tab(tab)) {
+					open = false;
+				}
+				ImGui::EndTabItem();
+			}
 
-			for (auto& file : pre_reader.files()) {
-				ImGui::TableNextColumn();
-				ImGui::Text("%s", file.filename().c_str());
-				ImGui::TableNextColumn();
-				ImGui::Text("%d", file.cmp_size());
-				ImGui::TableNextColumn();
-				ImGui::Text("%d", file.size());
-				ImGui::TableNextColumn();
-				ImGui::Text("%s", file.prepath().c_str());
+			if (!open) {
+				close = i;
 			}
+		}
+		select_tab = -1;
 
-			ImGui::EndTable();
+		if (ImGui::TabItemButton("+", ImGuiTabItemFlags_Trailing | ImGuiTabItemFlags_NoTooltip)) {
+			open_file = true;
+		}
+
+		ImGui::EndTabBar();
+
+		if (close >= 0) {
+			close_tab(close);
 		}
 	}
 
 	if (open_file) ImGui::OpenPopup("Open");
 	if (select_dir) ImGui::OpenPopup("Select directory...");
-	if (export_csv) ImGui::OpenPopup("Export csv");
+	if (export_manifest) ImGui::OpenPopup("Export manifest");
+	if (extract_tar) ImGui::OpenPopup("Extract to tar");
+	if (optimize) ImGui::OpenPopup("Optimize archive");
 }
 
-ExtractWindow::ExtractWindow() : fb_saveone(csv_out, do_csv) {
+ExtractWindow::ExtractWindow() : fb_saveone(manifest_out, do_manifest), fb_savetar(tar_out, do_tar), fb_optimize(optimize_out, do_optimize) {
 
 }
 
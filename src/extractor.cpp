@@ -0,0 +1,533 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Set to 0 to send every entry through nspre
+#ifndef NSPRE_GUI_ZERO_COPY
+#define NSPRE_GUI_ZERO_COPY 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+static const size_t COPY_BUFFER_SIZE = 1 << 20;
+
+// Staging buffer for O_DIRECT writes, and the alignment that covers both
+// 512 byte and 4 KiB logical blocks
+static const size_t DIRECT_IO_BUFFER_SIZE = 8 << 20;
+static const size_t DIRECT_IO_ALIGN = 4096;
+
+// Cap on how far prefetch() reads ahead, however big the window
+static const uint64_t PREFETCH_MAX_BYTES = 64 << 20;
+
+// Entries closer together than this are hinted as one range, the padding
+// between them gets read in anyway
+static const uint64_t PREFETCH_GAP = 4096;
+
+// Entries up to this size are batched when io_uring is in use, bigger ones
+// are bound by bandwidth rather than syscalls
+static const uint32_t URING_MAX_ENTRY = 256 << 10;
+
+Extractor::Extractor(nspre::Reader& reader, const std::filesystem::path& archive) : m_reader(reader) {
+#if NSPRE_GUI_ZERO_COPY
+	// Offsets come from the entry table, which is in the same order nspre
+	// reads it in. If it doesn't line up everything goes through nspre.
+	if (!m_layout.read(archive) || m_layout.entries().size() != reader.files().size()) {
+		return;
+	}
+
+	m_fd = open(archive.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if (m_fd < 0 || fstat(m_fd, &st)) {
+		return;
+	}
+
+	m_block_size = st.st_blksize;
+	m_archive_size = st.st_size;
+	m_direct = true;
+	posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+Extractor::~Extractor() {
+	m_uring.reset();
+	if (m_fd >= 0) {
+		close(m_fd);
+	}
+	if (m_memfd >= 0) {
+		close(m_memfd);
+	}
+	std::free(m_aligned);
+}
+
+// Entry indices sorted by where their data starts, so a pass over them reads
+// the archive front to back. Entry order without the entry table.
+std::vector<uint32_t> Extractor::offset_order(const std::vector<uint32_t>* subset) const {
+	std::vector<uint32_t> order;
+	if (subset) {
+		order = *subset;
+	}
+	else {
+		order.resize(m_reader.files().size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			order[i] = i;
+		}
+	}
+
+	if (m_direct) {
+		auto& entries = m_layout.entries();
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			return entries[a].data_offset < entries[b].data_offset;
+		});
+	}
+
+	return order;
+}
+
+// Call before extracting order[pos]. Asks the kernel to start reading the
+// entries up to the use_prefetch() window ahead, at most PREFETCH_MAX_BYTES
+// of them, with neighbouring entries hinted as one range. Does nothing
+// without the entry table.
+void Extractor::prefetch(const std::vector<uint32_t>& order, size_t pos) {
+	if (!m_direct || !m_prefetch_window) {
+		return;
+	}
+	if (pos == 0 || m_prefetched < pos) {
+		m_prefetched = pos;
+	}
+
+	auto& entries = m_layout.entries();
+	uint64_t ahead = 0;
+	for (size_t k = pos; k < m_prefetched; ++k) {
+		ahead += entries[order[k]].data_size();
+	}
+
+	uint64_t start = 0;
+	uint64_t end = 0;
+	while (m_prefetched < order.size() && m_prefetched < pos + m_prefetch_window && ahead < PREFETCH_MAX_BYTES) {
+		const PreLayoutEntry& e = entries[order[m_prefetched++]];
+		if (end && (e.header_offset < end || e.header_offset - end > PREFETCH_GAP)) {
+			posix_fadvise(m_fd, start, end - start, POSIX_FADV_WILLNEED);
+			end = 0;
+		}
+		if (!end) {
+			start = e.header_offset;
+		}
+		end = e.data_offset + e.data_size();
+		ahead += e.data_size();
+	}
+	if (end) {
+		posix_fadvise(m_fd, start, end - start, POSIX_FADV_WILLNEED);
+	}
+}
+
+// Small entries are queued on an io_uring writer. Returns false, leaving the
+// one file at a time path in place, if io_uring isn't available.
+bool Extractor::use_uring(unsigned depth) {
+	auto uring = std::make_unique<UringWriter>();
+	if (!uring->init(depth)) {
+		return false;
+	}
+
+	m_uring = std::move(uring);
+	return true;
+}
+
+bool Extractor::is_stored(size_t index) {
+	if (!m_direct) {
+		return false;
+	}
+
+	auto& file = m_reader.files()[index];
+	const PreLayoutEntry& e = m_layout.entries()[index];
+	return e.stored() && e.size == (uint32_t)file.size() && e.prepath == file.prepath();
+}
+
+// nspre only extracts to files, so compressed entries are decoded into a
+// memfd to be read back or copied on
+bool Extractor::decode(size_t index, uint64_t& size) {
+	if (m_memfd < 0) {
+		m_memfd = memfd_create("nspre-entry", MFD_CLOEXEC);
+	}
+	if (m_memfd < 0 || m_reader.files()[index].extract("/proc/self/fd/" + std::to_string(m_memfd))) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(m_memfd, &st)) {
+		return false;
+	}
+
+	size = st.st_size;
+	return true;
+}
+
+// Reads an entry's contents into memory
+bool Extractor::read(size_t index, std::vector<char>& data) {
+	if (is_stored(index)) {
+		const PreLayoutEntry& e = m_layout.entries()[index];
+		BufferPool::fit(data, e.size);
+		return pread(m_fd, data.data(), e.size, e.data_offset) == (ssize_t)e.size;
+	}
+
+	uint64_t size;
+	if (!decode(index, size)) {
+		return false;
+	}
+
+	BufferPool::fit(data, size);
+	return pread(m_memfd, data.data(), data.size(), 0) == (ssize_t)data.size();
+}
+
+static bool read_full(int fd, char* buf, size_t size, uint64_t offset) {
+	size_t done = 0;
+	while (done < size) {
+		ssize_t n = pread(fd, buf + done, size - done, offset + done);
+		if (n <= 0) {
+			return false;
+		}
+		done += n;
+	}
+
+	return true;
+}
+
+// Writes size bytes to a freshly created out_fd, taken from data if it's set
+// and from offset in fd otherwise. The blocks are reserved up front so big
+// outputs aren't fragmented. Outputs of at least the use_direct_io() size
+// skip the page cache, each chunk is staged in an aligned buffer and the
+// padding of the last block is cut off again at the end. Filesystems without
+// O_DIRECT, like tmpfs, get the normal path.
+bool Extractor::write_out(int out_fd, uint64_t size, int fd, uint64_t offset, const char* data) {
+	if (!size) {
+		return true;
+	}
+	fallocate(out_fd, FALLOC_FL_KEEP_SIZE, 0, size);
+
+	bool direct = m_direct_io_min && size >= m_direct_io_min &&
+		(m_aligned || posix_memalign((void**)&m_aligned, DIRECT_IO_ALIGN, DIRECT_IO_BUFFER_SIZE) == 0) &&
+		fcntl(out_fd, F_SETFL, fcntl(out_fd, F_GETFL) | O_DIRECT) == 0;
+	if (direct) {
+		++m_stats.direct_io;
+		for (uint64_t done = 0; done < size;) {
+			size_t n = std::min<uint64_t>(size - done, DIRECT_IO_BUFFER_SIZE);
+			if (data) {
+				std::memcpy(m_aligned, data + done, n);
+			}
+			else if (!read_full(fd, m_aligned, n, offset + done)) {
+				return false;
+			}
+
+			size_t padded = (n + DIRECT_IO_ALIGN - 1) & ~(DIRECT_IO_ALIGN - 1);
+			std::memset(m_aligned + n, 0, padded - n);
+			if (pwrite(out_fd, m_aligned, padded, done) != (ssize_t)padded) {
+				return false;
+			}
+			done += n;
+		}
+
+		return size % DIRECT_IO_ALIGN == 0 || ftruncate(out_fd, size) == 0;
+	}
+
+	if (data) {
+		uint64_t done = 0;
+		while (done < size) {
+			ssize_t n = write(out_fd, data + done, size - done);
+			if (n <= 0) {
+				return false;
+			}
+			done += n;
+		}
+
+		return true;
+	}
+
+	loff_t in_off = offset;
+	loff_t out_off = 0;
+	uint64_t left = size;
+	bool fallback = false;
+	while (left && !fallback) {
+		ssize_t n = copy_file_range(fd, &in_off, out_fd, &out_off, left, 0);
+		if (n > 0) {
+			left -= n;
+		}
+		else if (n < 0 && out_off == 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+			fallback = true;
+		}
+		else {
+			break;
+		}
+	}
+
+	if (fallback) {
+		PooledBuffer buf(left < COPY_BUFFER_SIZE ? left : COPY_BUFFER_SIZE);
+		while (left) {
+			ssize_t n = pread(fd, buf.data.data(), left < buf.data.size() ? left : buf.data.size(), in_off);
+			if (n <= 0 || write(out_fd, buf.data.data(), n) != n) {
+				break;
+			}
+			in_off += n;
+			left -= n;
+		}
+	}
+
+	return left == 0;
+}
+
+// Tries a reflink first, which needs the entry to start on a block boundary
+// and to either fill whole blocks or run to the end of the archive. Then
+// copy_file_range, and plain reads and writes where neither is supported.
+int Extractor::copy_stored(const PreLayoutEntry& e, const std::filesystem::path& out) {
+	int out_fd = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (out_fd < 0) {
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	uint64_t size = e.size;
+	bool ok = false;
+	bool aligned = m_block_size && e.data_offset % m_block_size == 0 &&
+		(size % m_block_size == 0 || e.data_offset + size == m_archive_size);
+	if (size && aligned) {
+		struct file_clone_range range;
+		range.src_fd = m_fd;
+		range.src_offset = e.data_offset;
+		range.src_length = size;
+		range.dest_offset = 0;
+		if (ioctl(out_fd, FICLONERANGE, &range) == 0) {
+			++m_stats.cloned;
+			ok = true;
+		}
+	}
+
+	ok = ok || write_out(out_fd, size, m_fd, e.data_offset, nullptr);
+	if (close(out_fd)) {
+		ok = false;
+	}
+	if (!ok) {
+		return -1;
+	}
+
+	++m_stats.stored;
+	m_stats.stored_bytes += size;
+	return 0;
+}
+
+// The entry is already decoded into the memfd
+int Extractor::copy_decoded(uint64_t size, const std::filesystem::path& out) {
+	int out_fd = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (out_fd < 0) {
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	bool ok = write_out(out_fd, size, m_memfd, 0, nullptr);
+	if (close(out_fd)) {
+		ok = false;
+	}
+	return ok ? 0 : -1;
+}
+
+int Extractor::write_file(const std::filesystem::path& out, const std::vector<char>& data) {
+	int out_fd = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (out_fd < 0) {
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	bool ok = write_out(out_fd, data.size(), -1, 0, data.data());
+	if (close(out_fd)) {
+		ok = false;
+	}
+	return ok ? 0 : -1;
+}
+
+static bool same_contents(const std::filesystem::path& path, const std::vector<char>& data) {
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) || (uint64_t)st.st_size != data.size()) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		return false;
+	}
+
+	PooledBuffer buf(data.size() < COPY_BUFFER_SIZE ? data.size() : COPY_BUFFER_SIZE);
+	size_t done = 0;
+	while (done < data.size()) {
+		ssize_t n = pread(fd, buf.data.data(), std::min(buf.data.size(), data.size() - done), done);
+		if (n <= 0 || std::memcmp(buf.data.data(), data.data() + done, n)) {
+			break;
+		}
+		done += n;
+	}
+
+	close(fd);
+	return done == data.size();
+}
+
+// Later copies of a payload become reflinks of the first one, so they stay
+// separate files, or hard links where the filesystem can't clone. The first
+// copy is compared byte for byte before anything is linked to it, since it
+// may have been overwritten by an entry with the same filename.
+bool Extractor::link_duplicate(uint64_t digest, const std::vector<char>& data, const std::filesystem::path& out) {
+	auto range = m_written.equal_range(digest);
+	for (auto it = range.first; it != range.second; ++it) {
+		const std::filesystem::path& first = it->second.path;
+		if (!same_contents(first, data)) {
+			continue;
+		}
+		if (first == out) {
+			return true;
+		}
+
+		unlink(out.c_str());
+		int src_fd = open(first.c_str(), O_RDONLY | O_CLOEXEC);
+		int out_fd = open(out.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+		bool cloned = src_fd >= 0 && out_fd >= 0 && ioctl(out_fd, FICLONE, src_fd) == 0;
+		if (src_fd >= 0) {
+			close(src_fd);
+		}
+		if (out_fd >= 0 && (close(out_fd) || !cloned)) {
+			unlink(out.c_str());
+			cloned = false;
+		}
+
+		return cloned || link(first.c_str(), out.c_str()) == 0;
+	}
+
+	return false;
+}
+
+// With io_uring an error may belong to an earlier entry, failed_path() says
+// which
+int Extractor::extract(size_t index, const std::filesystem::path& out) {
+	auto& file = m_reader.files()[index];
+	bool stored = is_stored(index);
+	bool batch = m_uring && (uint32_t)file.size() <= URING_MAX_ENTRY;
+
+	PooledBuffer entry(0);
+	std::vector<char>& data = entry.data;
+	if ((batch || m_dedup) && !read(index, data)) {
+		m_failed = out;
+		return -1;
+	}
+
+	int err;
+	uint64_t digest = 0;
+	bool dedup = m_dedup && data.size();
+	if (dedup) {
+		Hash64 hash;
+		hash.update(data.data(), data.size());
+		digest = hash.digest();
+
+		// A copy that is still queued has to be on disk before it can be
+		// linked to
+		auto range = m_written.equal_range(digest);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second.batched && it->second.uring_seq >= m_uring_adds - m_uring->queued()) {
+				if ((err = m_uring->flush())) {
+					m_failed = m_uring->failed_path();
+					return err;
+				}
+				break;
+			}
+		}
+
+		if (link_duplicate(digest, data, out)) {
+			++m_stats.linked;
+			m_stats.linked_bytes += data.size();
+			return 0;
+		}
+
+		// The path may be a link to an earlier copy from a previous run or
+		// an entry with the same filename, writing through it would change
+		// that copy as well
+		unlink(out.c_str());
+	}
+
+	if (batch) {
+		if (stored) {
+			++m_stats.stored;
+			m_stats.stored_bytes += data.size();
+		}
+		else {
+			++m_stats.decoded;
+		}
+		++m_stats.batched;
+		if (dedup) {
+			m_written.emplace(digest, Written{out, m_uring_adds, true});
+		}
+		++m_uring_adds;
+		if ((err = m_uring->add(out, std::move(data)))) {
+			m_failed = m_uring->failed_path();
+		}
+		return err;
+	}
+
+	if (stored) {
+		err = copy_stored(m_layout.entries()[index], out);
+	}
+	else if (m_dedup) {
+		// Already decoded for the hash
+		++m_stats.decoded;
+		err = write_file(out, data);
+	}
+	else if (m_direct_io_min && (uint64_t)file.size() >= m_direct_io_min) {
+		// nspre can't write with O_DIRECT, so the entry takes a detour
+		// through the memfd
+		++m_stats.decoded;
+		uint64_t size;
+		err = decode(index, size) ? copy_decoded(size, out) : -1;
+	}
+	else {
+		++m_stats.decoded;
+		err = file.extract(out);
+	}
+
+	if (err) {
+		m_failed = out;
+	}
+	else if (dedup) {
+		m_written.emplace(digest, Written{out, 0, false});
+	}
+	return err;
+}
+
+// Writes out whatever is still queued
+int Extractor::finish() {
+	int err = 0;
+	if (m_uring && (err = m_uring->flush())) {
+		m_failed = m_uring->failed_path();
+	}
+
+	return err;
+}
+
+}
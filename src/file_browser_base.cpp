@@ -22,12 +22,31 @@
 #include "nspre-gui.hpp"
 #include <filesystem>
 #include <vector>
+#include <algorithm>
+#include <cstdio>
 #include <cstring>
 
 namespace fs = std::filesystem;
 
 namespace ns {
 
+void format_size(char* buf, size_t buf_size, uint64_t size) {
+	static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+	double value = size;
+	int unit = 0;
+	while (value >= 1024.0 && unit < 4) {
+		value /= 1024.0;
+		++unit;
+	}
+
+	if (unit == 0) {
+		std::snprintf(buf, buf_size, "%llu B", (unsigned long long)size);
+	}
+	else {
+		std::snprintf(buf, buf_size, "%.1f %s", value, units[unit]);
+	}
+}
+
 // Sort strings 0-9,Aa-Zz instead of 0-9,A-Z,a-z
 int FileBrowserBase::compare_strings(const std::string& s0, const std::string& s1) {
 	int len = s0.size();
@@ -71,53 +90,136 @@ int FileBrowserBase::compare_strings(const std::string& s0, const std::string& s
 void FileBrowserBase::open_dir_base(std::filesystem::path path) {
 	m_dir_entries.clear();
 	m_file_entries.clear();
+	m_dir_meta.clear();
+	m_file_meta.clear();
 	m_previous_path = m_current_path;
 	m_current_path = fs::canonical(path);
 	fs::directory_iterator di(path);
-	std::vector<fs::directory_entry> files;
-	std::vector<fs::directory_entry> dirs;
-	int ecount = 0;
 	for (auto entry : di) {
-		++ecount;
 		if (entry.is_directory()) {
-			dirs.push_back(entry);
+			m_dir_entries.push_back({entry,false});
+			m_dir_meta.emplace_back();
+			m_dir_meta.back().name = entry.path().filename().string();
 		}
 		else if (entry.is_regular_file()) {
-			files.push_back(entry);
+			m_file_entries.push_back({entry,false});
+			m_file_meta.emplace_back();
+			m_file_meta.back().name = entry.path().filename().string();
 		}
 	}
 
-	bool unsorted;
-	do {
-		unsorted = false;
-		for (int i = 0; i < (int)dirs.size() - 1; ++i) {
-			int r = compare_strings(dirs[i].path().filename().string(), dirs[i + 1].path().filename().string());
-			if (r > 0) {
-				std::swap(dirs[i], dirs[i + 1]);
-				unsorted = true;
+	// Directories first, then files, so results can be told apart by index
+	std::vector<std::string> names;
+	names.reserve(m_dir_meta.size() + m_file_meta.size());
+	for (auto& m : m_dir_meta) {
+		names.push_back(m.name);
+	}
+	for (auto& m : m_file_meta) {
+		names.push_back(m.name);
+	}
+
+	m_statter.request(m_current_path, std::move(names));
+	sort_entries();
+}
+
+void FileBrowserBase::sort_entries() {
+	auto sort_order = [this](std::vector<int>& order, const std::vector<EntryMeta>& meta, bool dirs) {
+		order.resize(meta.size());
+		for (int i = 0; i < order.size(); ++i) {
+			order[i] = i;
+		}
+
+		// Directories have no meaningful size, keep them sorted by name
+		int column = m_sort_column;
+		if (dirs && column == SORT_SIZE) {
+			column = SORT_NAME;
+		}
+
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			int r;
+			if (column == SORT_SIZE) {
+				r = (meta[a].size > meta[b].size) - (meta[a].size < meta[b].size);
+			}
+			else if (column == SORT_MTIME) {
+				r = (meta[a].mtime > meta[b].mtime) - (meta[a].mtime < meta[b].mtime);
+			}
+			else {
+				r = 0;
+			}
+
+			if (r == 0) {
+				r = compare_strings(meta[a].name, meta[b].name);
 			}
+
+			return m_sort_ascending ? r < 0 : r > 0;
+		});
+	};
+
+	sort_order(m_dir_order, m_dir_meta, true);
+	sort_order(m_file_order, m_file_meta, false);
+}
+
+void FileBrowserBase::setup_entry_columns() {
+	ImGui::TableSetupScrollFreeze(0, 1);
+	ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_WidthStretch, 0, SORT_NAME);
+	ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed, 0, SORT_SIZE);
+	ImGui::TableSetupColumn("Modified", ImGuiTableColumnFlags_WidthFixed, 0, SORT_MTIME);
+}
+
+// Call once per frame after the header row
+void FileBrowserBase::update_entries() {
+	bool resort = false;
+
+	m_statter.poll(m_stat_results);
+	for (auto& r : m_stat_results) {
+		EntryMeta* m;
+		if (r.index < m_dir_meta.size()) {
+			m = &m_dir_meta[r.index];
+		}
+		else if (r.index - m_dir_meta.size() < m_file_meta.size()) {
+			m = &m_file_meta[r.index - m_dir_meta.size()];
+		}
+		else {
+			continue;
 		}
+
+		m->size = r.size;
+		m->mtime = r.mtime;
+		std::memcpy(m->mtime_text, r.mtime_text, sizeof(m->mtime_text));
+		m->stat_done = true;
 	}
-	while (unsorted);
 
-	do {
-		unsorted = false;
-		for (int i = 0; i < (int)files.size() - 1; ++i) {
-			int r = compare_strings(files[i].path().filename().string(), files[i + 1].path().filename().string());
-			if (r > 0) { 
-				std::swap(files[i], files[i + 1]);
-				unsorted = true;
-			}
+	if (m_stat_results.size() && m_sort_column != SORT_NAME) {
+		resort = true;
+	}
+
+	ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs();
+	if (specs && specs->SpecsDirty) {
+		if (specs->SpecsCount > 0) {
+			m_sort_column = specs->Specs[0].ColumnUserID;
+			m_sort_ascending = specs->Specs[0].SortDirection != ImGuiSortDirection_Descending;
 		}
+
+		specs->SpecsDirty = false;
+		resort = true;
 	}
-	while (unsorted);
 
-	for (auto e : dirs) {
-		m_dir_entries.push_back({e,false});
+	if (resort) {
+		sort_entries();
+	}
+}
+
+void FileBrowserBase::show_entry_columns(const EntryMeta& meta, bool is_dir) {
+	ImGui::TableNextColumn();
+	if (meta.stat_done && !is_dir) {
+		char size_buf[32];
+		format_size(size_buf, sizeof(size_buf), meta.size);
+		ImGui::Text("%s", size_buf);
 	}
 
-	for (auto e : files) {
-		m_file_entries.push_back({e,false});
+	ImGui::TableNextColumn();
+	if (meta.stat_done) {
+		ImGui::Text("%s", meta.mtime_text);
 	}
 }
 
@@ -139,8 +241,6 @@ void FileBrowserBase::show_top_region() {
 	}
 	ImGui::SameLine();
 	ImGui::Checkbox("Show hidden", &m_show_hidden);
-	ImGui::SameLine();
-	ImGui::Checkbox("Ascending", &m_sort_ascending);
 
 	ImGui::PushItemWidth(ImGui::GetContentRegionAvail().x);
 	ImGui::Text("%s", m_current_path.c_str());
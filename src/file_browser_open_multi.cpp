@@ -59,12 +59,12 @@ void FileBrowserOpenMulti::multi_select() {
 		else if (req.Type == ImGuiSelectionRequestType_SetRange) {
 			if (req.RangeFirstItem < req.RangeLastItem) {
 				for (int i = req.RangeFirstItem; i <= req.RangeLastItem; ++i) {
-					m_file_entries[i].second = req.Selected;
+					m_file_entries[m_file_order[i]].second = req.Selected;
 				}
 			}
 			else {
 				for (int i = req.RangeFirstItem; i >= req.RangeLastItem; --i) {
-					m_file_entries[i].second = req.Selected;
+					m_file_entries[m_file_order[i]].second = req.Selected;
 				}
 			}
 		}
@@ -81,34 +81,48 @@ void FileBrowserOpenMulti::show() {
 	ImVec2 list_size = ImGui::GetContentRegionAvail();
 	list_size.y = ImGui::GetContentRegionAvail().y - ImGui::GetFrameHeight() * 2.5;
 
-	if (ImGui::BeginListBox("###dirlist", list_size)) {
+	if (ImGui::BeginTable("###dirlist", 3, ImGuiTableFlags_ScrollY | ImGuiTableFlags_Sortable | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_RowBg, list_size)) {
+		setup_entry_columns();
+		ImGui::TableHeadersRow();
+		update_entries();
+
 		if (m_current_path != "/") {
-			if (ImGui::Selectable("..", false, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick)) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (ImGui::Selectable("..", false, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick | ImGuiSelectableFlags_SpanAllColumns)) {
 				if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
 					open_dir(m_current_path.parent_path());
 				}
 			}
 		}
 
-		for (int i_ = 0; i_ < m_dir_entries.size(); ++i_) {
-			int i;
-			if (m_sort_ascending) i = i_;
-			else i = (m_dir_entries.size() - 1) - i_;
-			auto& e = m_dir_entries[i].first;
+		for (int n = 0; n < m_dir_order.size(); ++n) {
+			int i = m_dir_order[n];
+			const EntryMeta& meta = m_dir_meta[i];
 
-			if (e.path().filename().string()[0] == '.' && !m_show_hidden) {
+			if (meta.name[0] == '.' && !m_show_hidden) {
 				continue;
 			}
 
 			std::stringstream epath;
-			epath << e.path().filename().string() << "/";
+			epath << meta.name << "/";
 
-			if (ImGui::Selectable(epath.str().c_str(), false, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick, {0,0})) {
+			bool enter = false;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (ImGui::Selectable(epath.str().c_str(), false, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick | ImGuiSelectableFlags_SpanAllColumns, {0,0})) {
 
 				if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
-					double_click(m_dir_entries, i);
+					enter = true;
 				}
 			} 
+			show_entry_columns(meta, true);
+
+			// Opening a directory replaces the entry lists, so stop here
+			if (enter) {
+				double_click(m_dir_entries, i);
+				break;
+			}
 		}
 
 		valid_selection = false;
@@ -116,35 +130,36 @@ void FileBrowserOpenMulti::show() {
 		msio = ImGui::BeginMultiSelect(ImGuiMultiSelectFlags_ClearOnClickVoid);
 		multi_select();
 
-		for (int i_ = 0; i_ < m_file_entries.size(); ++i_) {
-			int i;
-			if (m_sort_ascending) i = i_;
-			else i = (m_file_entries.size() - 1) - i_;
-
-			auto& e = m_file_entries[i].first;
+		// Selection user data is the position in the sorted order
+		for (int n = 0; n < m_file_order.size(); ++n) {
+			int i = m_file_order[n];
+			const EntryMeta& meta = m_file_meta[i];
 
 			if (m_file_entries[i].second) {
 				valid_selection = true;
 			}
 
-			if (e.path().filename().string()[0] == '.' && !m_show_hidden) {
+			if (meta.name[0] == '.' && !m_show_hidden) {
 				continue;
 			}
 
 			bool& selected = m_file_entries[i].second;
 
-			ImGui::SetNextItemSelectionUserData(i);
-			if (ImGui::Selectable(e.path().filename().c_str(), (bool*)&selected, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick)) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::SetNextItemSelectionUserData(n);
+			if (ImGui::Selectable(meta.name.c_str(), (bool*)&selected, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick | ImGuiSelectableFlags_SpanAllColumns)) {
 				if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
 					double_click(m_file_entries, i);
 				}
 			}
+			show_entry_columns(meta, false);
 		}
 
-		ImGui::EndMultiSelect();
+		msio = ImGui::EndMultiSelect();
 		multi_select();
 
-		ImGui::EndListBox();
+		ImGui::EndTable();
 	}
 
 	int select_count = 0;
@@ -171,6 +186,17 @@ void FileBrowserOpenMulti::show() {
 	ImGui::SameLine();
 	ImGui::EndDisabled();
 
+	if (ImGui::Button("Add folder")) {
+		create_window.drop_folder(m_current_path);
+		do_init = true;
+		ImGui::CloseCurrentPopup();
+	}
+	if (ImGui::IsItemHovered()) {
+		ImGui::SetTooltip("Add everything under %s", m_current_path.c_str());
+	}
+
+	ImGui::SameLine();
+
 	if (ImGui::Button("Cancel")) {
 		do_init = true;
 		ImGui::CloseCurrentPopup();
@@ -26,6 +26,17 @@ namespace ns {
 void FileBrowserOpenOne::open_dir(const std::filesystem::path& path) {
 	open_dir_base(path);
 	valid_selection = false;
+
+	// Sniff every file so archives with other extensions show up too
+	std::vector<fs::path> paths;
+	paths.reserve(m_file_entries.size());
+	for (auto& e : m_file_entries) {
+		paths.push_back(e.first.path());
+	}
+
+	m_archive_info.assign(m_file_entries.size(), ArchiveInfo());
+	m_sniffer.request(paths);
+
 	std::strncpy(m_fname_buffer, "(none)", INPUTTEXT_BUFFER_SIZE);
 }
 
@@ -69,66 +80,104 @@ void FileBrowserOpenOne::show() {
 
 	show_top_region();
 
+	m_sniffer.poll(m_sniff_results);
+	for (auto& r : m_sniff_results) {
+		if (r.first < m_archive_info.size()) {
+			m_archive_info[r.first] = r.second;
+		}
+	}
+
 	ImVec2 list_size = ImGui::GetContentRegionAvail();
 	list_size.y = ImGui::GetContentRegionAvail().y - ImGui::GetFrameHeight() * 3.6;
 
-	if (ImGui::BeginListBox("###dirlist", list_size)) {
+	if (ImGui::BeginTable("###dirlist", 6, ImGuiTableFlags_ScrollY | ImGuiTableFlags_Sortable | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_RowBg, list_size)) {
+		setup_entry_columns();
+		ImGui::TableSetupColumn("Entries", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort);
+		ImGui::TableSetupColumn("Unpacked", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort);
+		ImGui::TableSetupColumn("Ratio", ImGuiTableColumnFlags_WidthFixed | ImGuiTableColumnFlags_NoSort);
+		ImGui::TableHeadersRow();
+		update_entries();
+
 		if (m_current_path != "/") {
-			if (ImGui::Selectable("..", false, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick)) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (ImGui::Selectable("..", false, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick | ImGuiSelectableFlags_SpanAllColumns)) {
 				if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
 					open_dir(m_current_path.parent_path());
 				}
 			}
 		}
 
-		for (int i_ = 0; i_ < m_dir_entries.size(); ++i_) {
-			int i;
-			if (m_sort_ascending) i = i_;
-			else i = (m_dir_entries.size() - 1) - i_;
-			auto& e = m_dir_entries[i].first;
+		for (int n = 0; n < m_dir_order.size(); ++n) {
+			int i = m_dir_order[n];
+			const EntryMeta& meta = m_dir_meta[i];
 
-			if (e.path().filename().string()[0] == '.' && !m_show_hidden) {
+			if (meta.name[0] == '.' && !m_show_hidden) {
 				continue;
 			}
 
 			std::stringstream epath;
-			epath << e.path().filename().string() << "/";
+			epath << meta.name << "/";
 
-			if (ImGui::Selectable(epath.str().c_str(), false, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick, {0,0})) {
+			bool enter = false;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (ImGui::Selectable(epath.str().c_str(), false, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick | ImGuiSelectableFlags_SpanAllColumns, {0,0})) {
 
 				if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
-					double_click(m_dir_entries, i);
+					enter = true;
 				}
 			} 
-		}
+			show_entry_columns(meta, true);
 
-		for (int i_ = 0; i_ < m_file_entries.size(); ++i_) {
-			int i;
-			if (m_sort_ascending) i = i_;
-			else i = (m_file_entries.size() - 1) - i_;
+			// Opening a directory replaces the entry lists, so stop here
+			if (enter) {
+				double_click(m_dir_entries, i);
+				break;
+			}
+		}
 
+		char size_buf[32];
+		for (int n = 0; n < m_file_order.size(); ++n) {
+			int i = m_file_order[n];
 			auto& e = m_file_entries[i].first;
+			const EntryMeta& meta = m_file_meta[i];
+			const ArchiveInfo& info = m_archive_info[i];
 
-			if (e.path().filename().string()[0] == '.' && !m_show_hidden) {
+			if (meta.name[0] == '.' && !m_show_hidden) {
 				continue;
 			}
 
-			if (e.path().extension() != ".pre" && e.path().extension() != ".prx" && filter) {
+			if (e.path().extension() != ".pre" && e.path().extension() != ".prx" && !info.valid && filter) {
 				continue;
 			}
 
 			bool& selected = m_file_entries[i].second;
 
-			if (ImGui::Selectable(e.path().filename().c_str(), (bool*)&selected, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick, {0,0})) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (ImGui::Selectable(meta.name.c_str(), (bool*)&selected, ImGuiSelectableFlags_DontClosePopups | ImGuiSelectableFlags_AllowDoubleClick | ImGuiSelectableFlags_SpanAllColumns, {0,0})) {
 				single_click(m_file_entries, i);
 
 				if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0)) {
 					double_click(m_file_entries, i);
 				}
 			}
+
+			show_entry_columns(meta, false);
+
+			if (info.valid) {
+				ImGui::TableNextColumn();
+				ImGui::Text("%u", info.entries);
+				ImGui::TableNextColumn();
+				format_size(size_buf, sizeof(size_buf), info.size);
+				ImGui::Text("%s", size_buf);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.0f%%", info.ratio() * 100.0f);
+			}
 		}
 
-		ImGui::EndListBox();
+		ImGui::EndTable();
 	}
 
 	ImGui::Text("Filter");
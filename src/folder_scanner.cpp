@@ -0,0 +1,140 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+static const size_t SCAN_BATCH_SIZE = 512;
+
+std::string folder_internal_path(const fs::path& relative) {
+	std::string ipath = "\\" + relative.generic_string();
+	for (char& c : ipath) {
+		if (c == '/') {
+			c = '\\';
+		}
+	}
+
+	return ipath;
+}
+
+// Drains the queue, so there is only ever one of these walking the disk
+void FolderScanner::run(std::shared_ptr<State> state) {
+	NS_PROFILE_SCOPE("scan_folders");
+	std::vector<FileEntry> batch;
+
+	for (;;) {
+		Request request;
+		{
+			std::lock_guard<std::mutex> guard(state->mutex);
+			if (state->queue.empty()) {
+				state->running = false;
+				state->progress.scanning = false;
+				request_redraw();
+				return;
+			}
+
+			request = std::move(state->queue.front());
+			state->queue.pop_front();
+		}
+
+		auto publish = [&]() {
+			std::lock_guard<std::mutex> guard(state->mutex);
+			if (request.generation != state->generation) {
+				return false;
+			}
+
+			state->progress.found += batch.size();
+			for (FileEntry& f : batch) {
+				state->progress.files.push_back(std::move(f));
+			}
+			batch.clear();
+			request_redraw();
+			return true;
+		};
+
+		std::error_code ec;
+		fs::file_status status = fs::status(request.path, ec);
+		if (fs::is_regular_file(status)) {
+			batch.push_back({request.path, PLACEHOLDER_PREFIX + request.path.filename().string()});
+		}
+		else if (fs::is_directory(status)) {
+			fs::path root = request.path.lexically_normal();
+			bool current = true;
+			auto options = fs::directory_options::skip_permission_denied;
+			for (fs::recursive_directory_iterator it(root, options, ec), end; current && !ec && it != end; it.increment(ec)) {
+				if (!it->is_regular_file(ec)) {
+					continue;
+				}
+
+				batch.push_back({it->path(), folder_internal_path(it->path().lexically_relative(root))});
+				if (batch.size() == SCAN_BATCH_SIZE) {
+					current = publish();
+				}
+			}
+		}
+
+		if (!publish()) {
+			batch.clear();
+		}
+	}
+}
+
+void FolderScanner::add(const PathList& paths) {
+	std::lock_guard<std::mutex> guard(m_state->mutex);
+	for (const fs::path& path : paths) {
+		m_state->queue.push_back({path, m_state->generation});
+	}
+
+	if (!m_state->running && m_state->queue.size()) {
+		m_state->running = true;
+		m_state->progress.scanning = true;
+		m_state->progress.found = 0;
+		std::shared_ptr<State> state = m_state;
+		worker_pool.submit([state]() { run(state); });
+	}
+}
+
+void FolderScanner::cancel() {
+	std::lock_guard<std::mutex> guard(m_state->mutex);
+	++m_state->generation;
+	m_state->queue.clear();
+	m_state->progress.files.clear();
+}
+
+void FolderScanner::poll(FolderScanProgress& out) {
+	std::lock_guard<std::mutex> guard(m_state->mutex);
+	out.files = std::move(m_state->progress.files);
+	m_state->progress.files.clear();
+	out.found = m_state->progress.found;
+	out.scanning = m_state->progress.scanning;
+}
+
+FolderScanner::FolderScanner() : m_state(std::make_shared<State>()) {
+
+}
+
+FolderScanner::~FolderScanner() {
+	cancel();
+}
+
+}
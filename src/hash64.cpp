@@ -0,0 +1,75 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <cstring>
+
+namespace ns {
+
+static const uint64_t HASH_PRIME = 0x100000001b3ull;
+
+static uint64_t hash_mix(uint64_t h, uint64_t word) {
+	h ^= word;
+	h *= HASH_PRIME;
+	return (h << 31) | (h >> 33);
+}
+
+// Eight bytes at a time rather than FNV's one, so hashing keeps up with
+// reading from disk
+void Hash64::update(const void* data, size_t size) {
+	const unsigned char* p = (const unsigned char*)data;
+	m_length += size;
+
+	while (m_tail_size && size) {
+		m_tail[m_tail_size++] = *p++;
+		--size;
+		if (m_tail_size == 8) {
+			uint64_t word;
+			std::memcpy(&word, m_tail, 8);
+			m_state = hash_mix(m_state, word);
+			m_tail_size = 0;
+		}
+	}
+
+	while (size >= 8) {
+		uint64_t word;
+		std::memcpy(&word, p, 8);
+		m_state = hash_mix(m_state, word);
+		p += 8;
+		size -= 8;
+	}
+
+	while (size--) {
+		m_tail[m_tail_size++] = *p++;
+	}
+}
+
+uint64_t Hash64::digest() const {
+	uint64_t word = 0;
+	std::memcpy(&word, m_tail, m_tail_size);
+	uint64_t h = hash_mix(m_state, word ^ m_length);
+
+	// splitmix64 finalizer
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+	return h ^ (h >> 31);
+}
+
+}
@@ -0,0 +1,158 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+// More hits than this aren't useful to scroll through
+static const size_t INDEX_MAX_RESULTS = 10000;
+
+void IndexWindow::search() {
+	results.clear();
+	selected = -1;
+	if (!index) {
+		return;
+	}
+
+	uint64_t start = Profiler::now_ns();
+	index->search(query_buffer, results, INDEX_MAX_RESULTS);
+	search_ms = (Profiler::now_ns() - start) / 1e6;
+}
+
+void IndexWindow::show(bool* open) {
+	if (!*open) {
+		return;
+	}
+
+	// The saved index is read the first time the window is shown
+	if (!loaded) {
+		loaded = true;
+		scanning = true;
+		indexer.load(index_file());
+	}
+
+	if (scanning) {
+		indexer.poll(progress);
+		if (progress.done) {
+			scanning = false;
+			if (progress.index) {
+				index = std::move(progress.index);
+				search();
+			}
+
+			if (!root_buffer[0]) {
+				std::error_code ec;
+				std::string root = (index && index->root().size()) ? index->root() : fs::current_path(ec).string();
+				std::snprintf(root_buffer, sizeof(root_buffer), "%s", root.c_str());
+			}
+		}
+	}
+
+	ImGui::SetNextWindowSize({800, 500}, ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Find in archives", open)) {
+		ImGui::End();
+		return;
+	}
+
+	ImGui::InputText("Folder", root_buffer, INPUTTEXT_BUFFER_SIZE);
+	ImGui::SameLine();
+	ImGui::BeginDisabled(scanning || !root_buffer[0]);
+	if (ImGui::Button("Scan")) {
+		scanning = true;
+		indexer.scan(root_buffer, index, index_file());
+	}
+	ImGui::EndDisabled();
+
+	if (scanning && progress.scanning) {
+		if (progress.total) {
+			char overlay[64];
+			std::snprintf(overlay, sizeof(overlay), "%u / %u archives", progress.parsed, progress.total);
+			ImGui::ProgressBar((float)progress.parsed / progress.total, {ImGui::GetContentRegionAvail().x - 80, 0}, overlay);
+		}
+		else {
+			ImGui::Text("Looking for archives...");
+		}
+
+		ImGui::SameLine();
+		if (ImGui::Button("Cancel")) {
+			indexer.cancel();
+			scanning = false;
+		}
+	}
+	else if (index) {
+		ImGui::Text("%zu archives, %zu entries indexed", index->archives().size(), index->entries().size());
+	}
+	else if (!scanning) {
+		ImGui::Text("No index, scan a folder to build one");
+	}
+
+	if (ImGui::InputText("Search", query_buffer, INPUTTEXT_BUFFER_SIZE)) {
+		search();
+	}
+
+	if (query_buffer[0] && index) {
+		ImGui::Text("%zu%s hits in %.2f ms", results.size(), results.size() == INDEX_MAX_RESULTS ? "+" : "", search_ms);
+	}
+
+	if (results.size() && ImGui::BeginTable("index_results", 3, ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Path");
+		ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed);
+		ImGui::TableSetupColumn("Archive");
+		ImGui::TableHeadersRow();
+
+		ImGuiListClipper clipper;
+		clipper.Begin(results.size());
+		while (clipper.Step()) {
+			for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+				const IndexedEntry& e = index->entries()[results[i]];
+				const IndexedArchive& a = index->archives()[e.archive];
+				std::string name = index->name(results[i]);
+				char size[32];
+				format_size(size, sizeof(size), e.size);
+
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::PushID(i);
+				if (ImGui::Selectable(name.c_str(), selected == i, ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowDoubleClick)) {
+					selected = i;
+					if (ImGui::IsMouseDoubleClicked(0)) {
+						global.open_mode = true;
+						extract_window.open_pre(a.path, name);
+					}
+				}
+				ImGui::PopID();
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", size);
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", a.path.c_str());
+			}
+		}
+
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+
+}
@@ -28,6 +28,8 @@ static_assert(NSPRE_VERSION_MAJOR == 1);
 #include "imgui_impl_opengl3.h"
 #include <SDL2/SDL.h>
 #include <GL/gl.h>
+#include <atomic>
+#include <csignal>
 #include <cstdio>
 
 #ifndef NSPRE_GUI_VERSION
@@ -46,17 +48,200 @@ static_assert(NSPRE_VERSION_MAJOR == 1);
 #define NSPRE_GUI_FLIMIT 60
 #endif
 
+#ifndef NSPRE_GUI_IDLE
+#define NSPRE_GUI_IDLE 1
+#endif
+
+// How long to keep drawing after the last event so hover delays, tooltips
+// and popups have time to settle before going idle
+#ifndef NSPRE_GUI_ACTIVE_MS
+#define NSPRE_GUI_ACTIVE_MS 500
+#endif
+
 namespace ns {
 
 GlobalStruct global;
 ExtractWindow extract_window;
 CreateWindow create_window;
+IndexWindow index_window;
+DiffWindow diff_window;
 
 SDL_Window* window;
 SDL_GLContext context;
 
 int arg_vsync = NSPRE_GUI_VSYNC;
 int arg_flimit = NSPRE_GUI_FLIMIT;
+int arg_idle = NSPRE_GUI_IDLE;
+
+Uint32 redraw_event = (Uint32)-1;
+std::atomic<bool> redraw_pending(false);
+PathList drops;
+
+// Safe to call from any thread, wakes the main loop for one more frame
+void request_redraw() {
+	if (redraw_event == (Uint32)-1 || redraw_pending.exchange(true)) {
+		return;
+	}
+
+	SDL_Event e;
+	SDL_zero(e);
+	e.type = redraw_event;
+	SDL_PushEvent(&e);
+}
+
+// Returns true if the frame should be skipped
+bool process_event(SDL_Event& e) {
+	ImGui_ImplSDL2_ProcessEvent(&e); // Forward your event to backend
+	if (e.type == SDL_QUIT) global.quit = true;
+	else if (e.type == redraw_event) {
+		redraw_pending = false;
+	}
+	else if (e.type == SDL_DROPFILE) {
+		drops.push_back(e.drop.file);
+		SDL_free(e.drop.file);
+	}
+	else if (e.type == SDL_DROPCOMPLETE) {
+		if (global.open_mode) {
+			for (auto& path : drops) {
+				if (std::filesystem::is_regular_file(path)) {
+					extract_window.open_pre(path);
+				}
+			}
+		}
+		else {
+			create_window.drop_files(drops);
+		}
+
+		drops.clear();
+	}
+	else if (e.type == SDL_WINDOWEVENT_RESIZED) {
+		return true;
+	}
+
+	return false;
+}
+
+// Headless --diff. Exits like diff(1), 0 if the archives match, 1 if they
+// differ and 2 on errors.
+int diff_cli(const char* old_path, const char* new_path, const char* out, int format, bool all) {
+	ArchiveDiff diff;
+	diff.old_path = old_path;
+	diff.new_path = new_path;
+
+	OperationTimer timer("diff", new_path);
+	int err = diff_archives(diff);
+	timer.finish(diff.added + diff.removed + diff.modified + diff.unchanged, err == 0);
+	if (err) {
+		std::fprintf(stderr, "can't read entry table of \"%s\"\n", err == 1 ? old_path : new_path);
+		worker_pool.shutdown();
+		return 2;
+	}
+
+	std::filesystem::path out_path = out ? out : "-";
+	if (write_diff(diff, out_path, format, all)) {
+		std::fprintf(stderr, "can't write diff to \"%s\"\n", out_path.c_str());
+		worker_pool.shutdown();
+		return 2;
+	}
+
+	std::fprintf(stderr, "%u added, %u removed, %u modified, %u unchanged\n", diff.added, diff.removed, diff.modified, diff.unchanged);
+	worker_pool.shutdown();
+	return (diff.added || diff.removed || diff.modified) ? 1 : 0;
+}
+
+// Headless --tar. Entries are picked by substring of their tar path, all of
+// them if there are no patterns.
+int tar_cli(const char* archive, const char* out, const std::vector<const char*>& include) {
+	nspre::Reader reader;
+	if (reader.open(archive)) {
+		std::fprintf(stderr, "can't open \"%s\"\n", archive);
+		return 2;
+	}
+
+	std::vector<uint32_t> subset;
+	auto& files = reader.files();
+	for (size_t i = 0; i < files.size(); ++i) {
+		std::string path = tar_path(files[i].prepath());
+		for (const char* pattern : include) {
+			if (path.find(pattern) != std::string::npos) {
+				subset.push_back(i);
+				break;
+			}
+		}
+	}
+
+	std::string failed;
+	OperationTimer timer("tar", archive);
+	int err = write_tar(reader, archive, out ? out : "-", include.size() ? &subset : nullptr, &failed);
+	timer.finish(include.size() ? subset.size() : files.size(), err == 0);
+	if (err == nspre::Error::FILE_OPEN) {
+		std::fprintf(stderr, "error extracting \"%s\"\n", failed.c_str());
+	}
+	else if (err) {
+		std::fprintf(stderr, "can't write tar to \"%s\"\n", out ? out : "stdout");
+	}
+
+	return err ? 2 : 0;
+}
+
+int optimize_cli(const char* in, const char* out) {
+	OptimizeStats stats;
+	OperationTimer timer("optimize", in);
+	int err = optimize_pre(in, out, stats);
+	timer.finish(stats.entries, err == 0);
+	if (err == nspre::Error::FILE_OPEN) {
+		std::fprintf(stderr, "can't read \"%s\"\n", in);
+	}
+	else if (err) {
+		std::fprintf(stderr, "can't write \"%s\"\n", out);
+	}
+	else {
+		std::printf("%u of %u entries recompressed smaller, %llu -> %llu bytes (%llu saved) in %.0f ms\n", stats.improved, stats.entries,
+			(unsigned long long)stats.bytes_before, (unsigned long long)stats.bytes_after, (unsigned long long)(stats.bytes_before - stats.bytes_after), stats.ms);
+	}
+
+	worker_pool.shutdown();
+	return err ? 2 : 0;
+}
+
+// Headless watch mode. Every file under dir is an input, with its path
+// relative to dir as the internal path, and out is rebuilt until SIGINT or
+// SIGTERM.
+int watch_cli(const char* out, const char* dir, const PackOptions& options) {
+	std::vector<nspre::Subfile> subfiles;
+	std::error_code ec;
+	std::filesystem::path root = std::filesystem::path(dir).lexically_normal();
+	auto dir_options = std::filesystem::directory_options::skip_permission_denied;
+	for (std::filesystem::recursive_directory_iterator it(root, dir_options, ec), end; !ec && it != end; it.increment(ec)) {
+		if (it->is_regular_file(ec) && !std::filesystem::equivalent(it->path(), out, ec)) {
+			subfiles.push_back({it->path(), folder_internal_path(it->path().lexically_relative(root))});
+		}
+	}
+	if (subfiles.empty()) {
+		std::fprintf(stderr, "no files in \"%s\"\n", dir);
+		return 2;
+	}
+
+	// Blocked before the watcher starts so only this thread takes them
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+	ArchiveWatcher watcher;
+	if (!watcher.start(subfiles, out, options)) {
+		std::fprintf(stderr, "can't watch \"%s\"\n", dir);
+		return 2;
+	}
+	std::printf("Watching %zu files in \"%s\" for \"%s\"\n", subfiles.size(), dir, out);
+
+	int sig;
+	sigwait(&signals, &sig);
+	watcher.stop();
+	worker_pool.shutdown();
+	return 0;
+}
 
 void top_window() {
 	ImVec2 size;
@@ -111,6 +296,21 @@ void top_window() {
 }
 
 int main(int argc, char** argv) {
+	const char* diff_old = 0;
+	const char* diff_new = 0;
+	const char* diff_out = 0;
+	int diff_format = ns::MANIFEST_CSV;
+	bool diff_all = false;
+	const char* tar_archive = 0;
+	const char* tar_out = 0;
+	std::vector<const char*> tar_include;
+	const char* optimize_in = 0;
+	const char* optimize_out = 0;
+	const char* watch_out = 0;
+	const char* watch_dir = 0;
+	ns::PackOptions pack_options;
+	const char* metrics_out = 0;
+	int metrics_format = ns::METRICS_JSONL;
 
 	for (int i = 1; i < argc; ++i) {
 		bool has_val = (i + 1 < argc);
@@ -126,6 +326,130 @@ int main(int argc, char** argv) {
 		else if (std::strcmp("--vsync-enable", argv[i]) == 0) {
 			ns::arg_vsync = 1;
 		}
+		else if (std::strcmp("--idle-disable", argv[i]) == 0) {
+			ns::arg_idle = 0;
+		}
+		else if (std::strcmp("--idle-enable", argv[i]) == 0) {
+			ns::arg_idle = 1;
+		}
+		else if (has_val && (std::strcmp("--trace", argv[i]) == 0)) {
+			if (!ns::profiler.start_trace(argv[i + 1])) {
+				std::fprintf(stderr, "can't create trace file \"%s\"\n", argv[i + 1]);
+			}
+
+			++i;
+		}
+		else if ((i + 2 < argc) && (std::strcmp("--diff", argv[i]) == 0)) {
+			diff_old = argv[i + 1];
+			diff_new = argv[i + 2];
+			i += 2;
+		}
+		else if (has_val && (std::strcmp("--diff-out", argv[i]) == 0)) {
+			diff_out = argv[i + 1];
+			++i;
+		}
+		else if (has_val && (std::strcmp("--diff-format", argv[i]) == 0)) {
+			if (std::strcmp("jsonl", argv[i + 1]) == 0) {
+				diff_format = ns::MANIFEST_JSONL;
+			}
+			else if (std::strcmp("csv", argv[i + 1]) == 0) {
+				diff_format = ns::MANIFEST_CSV;
+			}
+			else {
+				std::fprintf(stderr, "invalid diff format \"%s\"\n", argv[i + 1]);
+			}
+
+			++i;
+		}
+		else if (std::strcmp("--diff-all", argv[i]) == 0) {
+			diff_all = true;
+		}
+		else if (has_val && (std::strcmp("--tar", argv[i]) == 0)) {
+			tar_archive = argv[i + 1];
+			++i;
+		}
+		else if (has_val && (std::strcmp("--tar-out", argv[i]) == 0)) {
+			tar_out = argv[i + 1];
+			++i;
+		}
+		else if (has_val && (std::strcmp("--tar-include", argv[i]) == 0)) {
+			tar_include.push_back(argv[i + 1]);
+			++i;
+		}
+		else if (has_val && (std::strcmp("--optimize", argv[i]) == 0)) {
+			optimize_in = argv[i + 1];
+			++i;
+		}
+		else if (has_val && (std::strcmp("--optimize-out", argv[i]) == 0)) {
+			optimize_out = argv[i + 1];
+			++i;
+		}
+		else if (has_val && (std::strcmp("--watch", argv[i]) == 0)) {
+			watch_out = argv[i + 1];
+			++i;
+		}
+		else if (has_val && (std::strcmp("--watch-dir", argv[i]) == 0)) {
+			watch_dir = argv[i + 1];
+			++i;
+		}
+		else if (has_val && (std::strcmp("--store-ratio", argv[i]) == 0)) {
+			try {
+				pack_options.store_ratio = std::stof(argv[i + 1]);
+				pack_options.auto_store = true;
+			}
+			catch (...) {
+				std::fprintf(stderr, "invalid store ratio value \"%s\"\n", argv[i + 1]);
+			}
+
+			++i;
+		}
+		else if (has_val && (std::strcmp("--metrics", argv[i]) == 0)) {
+			metrics_out = argv[i + 1];
+			++i;
+		}
+		else if (has_val && (std::strcmp("--metrics-format", argv[i]) == 0)) {
+			if (std::strcmp("jsonl", argv[i + 1]) == 0) {
+				metrics_format = ns::METRICS_JSONL;
+			}
+			else if (std::strcmp("prometheus", argv[i + 1]) == 0) {
+				metrics_format = ns::METRICS_PROMETHEUS;
+			}
+			else {
+				std::fprintf(stderr, "invalid metrics format \"%s\"\n", argv[i + 1]);
+			}
+
+			++i;
+		}
+		else if (has_val && (std::strcmp("--uring-depth", argv[i]) == 0)) {
+			try {
+				ns::global.uring_depth = std::stoul(argv[i + 1]);
+			}
+			catch (...) {
+				std::fprintf(stderr, "invalid queue depth value \"%s\"\n", argv[i + 1]);
+			}
+
+			++i;
+		}
+		else if (has_val && (std::strcmp("--direct-io", argv[i]) == 0)) {
+			try {
+				ns::global.direct_io_min = (uint64_t)std::stoull(argv[i + 1]) << 20;
+			}
+			catch (...) {
+				std::fprintf(stderr, "invalid direct io size value \"%s\"\n", argv[i + 1]);
+			}
+
+			++i;
+		}
+		else if (has_val && (std::strcmp("--memory-budget", argv[i]) == 0)) {
+			try {
+				ns::global.memory_budget = (uint64_t)std::stoull(argv[i + 1]) << 20;
+			}
+			catch (...) {
+				std::fprintf(stderr, "invalid memory budget value \"%s\"\n", argv[i + 1]);
+			}
+
+			++i;
+		}
 		else if (has_val && (std::strcmp("--frame-limit", argv[i]) == 0)) {
 			try {
 				ns::arg_flimit = std::stoi(argv[i + 1]);
@@ -141,6 +465,34 @@ int main(int argc, char** argv) {
 		}
 	}
 
+	if (metrics_out && !ns::operation_log.open(metrics_out, metrics_format)) {
+		std::fprintf(stderr, "can't write metrics to \"%s\"\n", metrics_out);
+	}
+
+	if (diff_old) {
+		return ns::diff_cli(diff_old, diff_new, diff_out, diff_format, diff_all);
+	}
+
+	if (tar_archive) {
+		return ns::tar_cli(tar_archive, tar_out, tar_include);
+	}
+
+	if (optimize_in) {
+		if (!optimize_out) {
+			std::fprintf(stderr, "--optimize needs --optimize-out\n");
+			return 2;
+		}
+		return ns::optimize_cli(optimize_in, optimize_out);
+	}
+
+	if (watch_out) {
+		if (!watch_dir) {
+			std::fprintf(stderr, "--watch needs --watch-dir\n");
+			return 2;
+		}
+		return ns::watch_cli(watch_out, watch_dir, pack_options);
+	}
+
 	std::printf("nspre-gui version %s\n", NSPRE_GUI_VERSION);
 
 	if (SDL_Init(SDL_INIT_EVERYTHING)) {
@@ -148,6 +500,8 @@ int main(int argc, char** argv) {
 		return -1;
 	}
 
+	ns::redraw_event = SDL_RegisterEvents(1);
+
 	if (SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3) ||
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3)
 	) {
@@ -185,53 +539,65 @@ int main(int argc, char** argv) {
 	ImGui_ImplSDL2_InitForOpenGL(ns::window, ns::context);
 	ImGui_ImplOpenGL3_Init();
 
-	ns::PathList drops;
 	bool skip;
 	SDL_Event e;
 	uint64_t then = 0;
 	uint64_t rate = SDL_GetPerformanceFrequency();
 	uint64_t dtime = rate / ns::arg_flimit;
+	uint64_t active_time = rate * NSPRE_GUI_ACTIVE_MS / 1000;
+	uint64_t last_event = SDL_GetPerformanceCounter();
 
 	while (!ns::global.quit) {
+		skip = false;
+
+		// Block while there is nothing to draw. Input, background job progress
+		// (via request_redraw) and window events all wake the loop up.
+		if (ns::arg_idle) {
+			bool hidden = SDL_GetWindowFlags(ns::window) & (SDL_WINDOW_HIDDEN | SDL_WINDOW_MINIMIZED);
+			bool active = (SDL_GetPerformanceCounter() - last_event) < active_time;
+
+			if (hidden || !active) {
+				// Text fields still need the cursor to blink
+				int timeout = ns::global.io->WantTextInput ? 500 : -1;
+				int got;
+				if (hidden || timeout < 0) {
+					got = SDL_WaitEvent(&e);
+				}
+				else {
+					got = SDL_WaitEventTimeout(&e, timeout);
+				}
+
+				if (got) {
+					skip = ns::process_event(e);
+					last_event = SDL_GetPerformanceCounter();
+				}
+
+				if (hidden) {
+					continue;
+				}
+			}
+		}
 
 		// Limit the frame rate
 		uint64_t now = SDL_GetPerformanceCounter();
 		uint64_t delta = now - then;
-		if (delta >= dtime) {
-			then = now;
-		}
-		else {
+		if (delta < dtime) {
 #ifdef NSPRE_GUI_SLEEPWAIT
-			if ((dtime - delta) > (rate / 100)) {
-				SDL_Delay(1);
-			}
+			SDL_Delay(((dtime - delta) * 1000 + rate - 1) / rate);
+#else
+			while (SDL_GetPerformanceCounter() - then < dtime) {}
 #endif
-			continue;
 		}
-
-		skip = false;
-		while (SDL_PollEvent(&e)) {
-			ImGui_ImplSDL2_ProcessEvent(&e); // Forward your event to backend
-			if (e.type == SDL_QUIT) ns::global.quit = true;
-			else if (e.type == SDL_DROPFILE && std::filesystem::is_regular_file(e.drop.file)) {
-				drops.push_back(e.drop.file);
-				SDL_free(e.drop.file);
-			}
-			else if (e.type == SDL_DROPCOMPLETE) {
-				if (ns::global.open_mode) {
-					if (drops.size()) {
-						ns::extract_window.open_pre(drops[0]);
-					}
-				}
-				else {
-					ns::create_window.drop_files(drops);
+		then = SDL_GetPerformanceCounter();
+		uint64_t frame_start = ns::Profiler::now_ns();
+
+		{
+			NS_PROFILE_SCOPE("events");
+			while (SDL_PollEvent(&e)) {
+				if (ns::process_event(e)) {
+					skip = true;
 				}
-
-				drops.clear();
-			}
-			else if (e.type == SDL_WINDOWEVENT_RESIZED) {
-				skip = true;
-				continue;
+				last_event = SDL_GetPerformanceCounter();
 			}
 		}
 
@@ -244,11 +610,17 @@ int main(int argc, char** argv) {
 
 		// (After event loop)
 		// Start the Dear ImGui frame
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplSDL2_NewFrame();
-		ImGui::NewFrame();
+		{
+			NS_PROFILE_SCOPE("new_frame");
+			ImGui_ImplOpenGL3_NewFrame();
+			ImGui_ImplSDL2_NewFrame();
+			ImGui::NewFrame();
+		}
 
-		ns::top_window();
+		{
+			NS_PROFILE_SCOPE("top_window");
+			ns::top_window();
+		}
 		
 		if (ns::global.show_debug) {
 			ImGui::ShowDebugLogWindow();
@@ -258,15 +630,34 @@ int main(int argc, char** argv) {
 			ImGui::ShowDemoWindow(); // Show demo window! :)
 		}
 
+		ns::index_window.show(&ns::global.show_index);
+		ns::diff_window.show(&ns::global.show_diff);
+		ns::profiler.show(&ns::global.show_profiler);
+		ns::operation_log.show(&ns::global.show_operations);
+
 		// Rendering
 		// (Your code clears your framebuffer, renders your other stuff etc.)
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		{
+			NS_PROFILE_SCOPE("render");
+			ImGui::Render();
+		}
+		{
+			NS_PROFILE_SCOPE("render_draw_data");
+			ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		}
 		// (Your code calls SDL_GL_SwapWindow() etc.)
-		SDL_GL_SwapWindow(ns::window);
+		{
+			NS_PROFILE_SCOPE("swap");
+			SDL_GL_SwapWindow(ns::window);
+		}
 
+		if (ns::profiler.enabled()) {
+			ns::profiler.frame(frame_start, ns::Profiler::now_ns());
+		}
 	}
 
+	ns::worker_pool.shutdown();
+	ns::profiler.end_trace();
 	SDL_Quit();
 	return 0;
 }
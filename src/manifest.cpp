@@ -0,0 +1,399 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ns {
+
+// Rows are formatted into one buffer that is written out whenever it fills
+// up, so a 50k entry manifest takes a handful of write calls
+static const size_t MANIFEST_BUFFER_SIZE = 1 << 20;
+
+class ManifestBuffer {
+	std::string m_buf;
+	int m_fd;
+	bool m_failed = false;
+public:
+	ManifestBuffer(int fd) : m_fd(fd) {
+		m_buf.reserve(MANIFEST_BUFFER_SIZE + 4096);
+	}
+
+	bool flush() {
+		size_t done = 0;
+		while (!m_failed && done < m_buf.size()) {
+			ssize_t n = write(m_fd, m_buf.data() + done, m_buf.size() - done);
+			if (n < 0) {
+				m_failed = true;
+			}
+			else {
+				done += n;
+			}
+		}
+
+		m_buf.clear();
+		return !m_failed;
+	}
+
+	void row_done() {
+		if (m_buf.size() >= MANIFEST_BUFFER_SIZE) {
+			flush();
+		}
+	}
+
+	void put(char c) { m_buf.push_back(c); }
+	void put(const char* s) { m_buf.append(s); }
+	void put(const std::string& s) { m_buf.append(s); }
+
+	void put_uint(uint64_t v) {
+		char tmp[24];
+		auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+		m_buf.append(tmp, r.ptr - tmp);
+	}
+
+	void put_hex(uint64_t v) {
+		static const char digits[] = "0123456789abcdef";
+		char tmp[16];
+		for (int i = 15; i >= 0; --i) {
+			tmp[i] = digits[v & 15];
+			v >>= 4;
+		}
+		m_buf.append(tmp, 16);
+	}
+
+	void put_ratio(float r) {
+		char tmp[32];
+		int n = std::snprintf(tmp, sizeof(tmp), "%.4f", r);
+		m_buf.append(tmp, n);
+	}
+
+	void put_csv(const std::string& s) {
+		if (s.find_first_of(",\"\n") == std::string::npos) {
+			m_buf.append(s);
+			return;
+		}
+
+		m_buf.push_back('"');
+		for (char c : s) {
+			if (c == '"') m_buf.push_back('"');
+			m_buf.push_back(c);
+		}
+		m_buf.push_back('"');
+	}
+
+	void put_json(const std::string& s) {
+		m_buf.push_back('"');
+		for (unsigned char c : s) {
+			if (c == '"' || c == '\\') {
+				m_buf.push_back('\\');
+				m_buf.push_back(c);
+			}
+			else if (c < 0x20) {
+				char tmp[8];
+				std::snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+				m_buf.append(tmp);
+			}
+			else {
+				m_buf.push_back(c);
+			}
+		}
+		m_buf.push_back('"');
+	}
+
+	void put_u16(uint16_t v) {
+		put((char)(v & 0xff));
+		put((char)(v >> 8));
+	}
+
+	void put_u32(uint32_t v) {
+		for (int i = 0; i < 4; ++i) {
+			put((char)((v >> (i * 8)) & 0xff));
+		}
+	}
+
+	void put_u64(uint64_t v) {
+		put_u32(v & 0xffffffff);
+		put_u32(v >> 32);
+	}
+
+	void put_bin(const std::string& s) {
+		uint16_t len = s.size() > 0xffff ? 0xffff : s.size();
+		put_u16(len);
+		m_buf.append(s, 0, len);
+	}
+};
+
+// Hash of an entry's bytes as stored, compressed or not
+bool hash_entry(int fd, const PreLayoutEntry& e, std::vector<char>& buf, uint64_t& hash) {
+	Hash64 h;
+	uint64_t offset = e.data_offset;
+	uint64_t left = e.data_size();
+	while (left) {
+		ssize_t n = pread(fd, buf.data(), left < buf.size() ? left : buf.size(), offset);
+		if (n <= 0) {
+			return false;
+		}
+		h.update(buf.data(), n);
+		offset += n;
+		left -= n;
+	}
+
+	hash = h.digest();
+	return true;
+}
+
+const char* manifest_extension(int format) {
+	if (format == MANIFEST_JSONL) return ".jsonl";
+	if (format == MANIFEST_BINARY) return ".nsmf";
+	return ".csv";
+}
+
+const char* diff_change_name(int change) {
+	switch (change) {
+	case DIFF_ADDED: return "added";
+	case DIFF_REMOVED: return "removed";
+	case DIFF_MODIFIED: return "modified";
+	default: return "unchanged";
+	}
+}
+
+// csv keeps the original layout (trailing comma, no newline after the last
+// row) with any extra columns appended after the path. The binary format is
+// "NSMF", u32 version, u32 column flags, u32 count, then per entry u32 size,
+// u32 compressed size, optional u64 offset, f32 ratio and u64 hash, and the
+// file name and path as u16 length prefixed strings. Everything is little
+// endian.
+int write_manifest(nspre::Reader& reader, const std::filesystem::path& archive, const std::filesystem::path& path, const ManifestOptions& options) {
+	auto& files = reader.files();
+	size_t count = files.size();
+
+	// Offsets and hashes come from the entry table, which is in the same
+	// order nspre reads it in
+	PreLayout layout;
+	int archive_fd = -1;
+	if (options.columns & (MANIFEST_OFFSET | MANIFEST_HASH)) {
+		if (!layout.read(archive) || layout.entries().size() != count) {
+			return nspre::Error::FILE_OPEN;
+		}
+	}
+
+	if (options.columns & MANIFEST_HASH) {
+		archive_fd = open(archive.c_str(), O_RDONLY | O_CLOEXEC);
+		if (archive_fd < 0) {
+			return nspre::Error::FILE_OPEN;
+		}
+	}
+
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		if (archive_fd >= 0) close(archive_fd);
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	ManifestBuffer out(fd);
+	PooledBuffer read_buf(archive_fd >= 0 ? 1 << 20 : 0);
+
+	if (options.format == MANIFEST_BINARY) {
+		out.put("NSMF");
+		out.put_u32(1);
+		out.put_u32(options.columns);
+		out.put_u32(count);
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < count && ok; ++i) {
+		auto& f = files[i];
+		uint32_t size = f.size();
+		uint32_t cmp_size = f.cmp_size();
+		uint64_t offset = 0;
+		uint64_t hash = 0;
+		float ratio = (cmp_size && size) ? (float)cmp_size / (float)size : 1.0f;
+
+		if (options.columns & MANIFEST_OFFSET) {
+			offset = layout.entries()[i].data_offset;
+		}
+
+		if (options.columns & MANIFEST_HASH) {
+			ok = hash_entry(archive_fd, layout.entries()[i], read_buf.data, hash);
+		}
+
+		if (options.format == MANIFEST_CSV) {
+			out.put_csv(f.filename());
+			out.put(',');
+			out.put_uint(cmp_size);
+			out.put(',');
+			out.put_uint(size);
+			out.put(',');
+			out.put_csv(f.prepath());
+			out.put(',');
+			if (options.columns & MANIFEST_OFFSET) {
+				out.put_uint(offset);
+				out.put(',');
+			}
+			if (options.columns & MANIFEST_RATIO) {
+				out.put_ratio(ratio);
+				out.put(',');
+			}
+			if (options.columns & MANIFEST_HASH) {
+				out.put_hex(hash);
+				out.put(',');
+			}
+			if (i + 1 < count) {
+				out.put('\n');
+			}
+		}
+		else if (options.format == MANIFEST_JSONL) {
+			out.put("{\"file\":");
+			out.put_json(f.filename());
+			out.put(",\"path\":");
+			out.put_json(f.prepath());
+			out.put(",\"size\":");
+			out.put_uint(size);
+			out.put(",\"cmp_size\":");
+			out.put_uint(cmp_size);
+			if (options.columns & MANIFEST_OFFSET) {
+				out.put(",\"offset\":");
+				out.put_uint(offset);
+			}
+			if (options.columns & MANIFEST_RATIO) {
+				out.put(",\"ratio\":");
+				out.put_ratio(ratio);
+			}
+			if (options.columns & MANIFEST_HASH) {
+				out.put(",\"hash\":\"");
+				out.put_hex(hash);
+				out.put('"');
+			}
+			out.put("}\n");
+		}
+		else {
+			out.put_u32(size);
+			out.put_u32(cmp_size);
+			if (options.columns & MANIFEST_OFFSET) {
+				out.put_u64(offset);
+			}
+			if (options.columns & MANIFEST_RATIO) {
+				uint32_t bits;
+				std::memcpy(&bits, &ratio, 4);
+				out.put_u32(bits);
+			}
+			if (options.columns & MANIFEST_HASH) {
+				out.put_u64(hash);
+			}
+			out.put_bin(f.filename());
+			out.put_bin(f.prepath());
+		}
+
+		out.row_done();
+	}
+
+	if (archive_fd >= 0) {
+		close(archive_fd);
+	}
+
+	ok = out.flush() && ok;
+	if (close(fd)) {
+		ok = false;
+	}
+
+	return ok ? 0 : -1;
+}
+
+
+// One row per added, removed or modified entry, sorted by path. csv has a
+// header row, hashes are left empty where they weren't computed. Any format
+// other than JSON Lines is written as csv. A path of "-" writes to stdout.
+int write_diff(const ArchiveDiff& diff, const std::filesystem::path& path, int format, bool unchanged) {
+	int fd = (path == "-") ? dup(STDOUT_FILENO) : open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	ManifestBuffer out(fd);
+	if (format != MANIFEST_JSONL) {
+		out.put("change,path,old_size,new_size,old_cmp_size,new_cmp_size,old_hash,new_hash\n");
+	}
+
+	for (auto& d : diff.entries) {
+		if (d.change == DIFF_UNCHANGED && !unchanged) {
+			continue;
+		}
+
+		bool has_old = d.change != DIFF_ADDED;
+		bool has_new = d.change != DIFF_REMOVED;
+		if (format == MANIFEST_JSONL) {
+			out.put("{\"change\":\"");
+			out.put(diff_change_name(d.change));
+			out.put("\",\"path\":");
+			out.put_json(d.prepath);
+			if (has_old) {
+				out.put(",\"old_size\":");
+				out.put_uint(d.old_size);
+				out.put(",\"old_cmp_size\":");
+				out.put_uint(d.old_cmp_size);
+			}
+			if (has_new) {
+				out.put(",\"new_size\":");
+				out.put_uint(d.new_size);
+				out.put(",\"new_cmp_size\":");
+				out.put_uint(d.new_cmp_size);
+			}
+			if (d.hashed) {
+				out.put(",\"old_hash\":\"");
+				out.put_hex(d.old_hash);
+				out.put("\",\"new_hash\":\"");
+				out.put_hex(d.new_hash);
+				out.put('"');
+			}
+			out.put("}\n");
+		}
+		else {
+			out.put(diff_change_name(d.change));
+			out.put(',');
+			out.put_csv(d.prepath);
+			out.put(',');
+			if (has_old) out.put_uint(d.old_size);
+			out.put(',');
+			if (has_new) out.put_uint(d.new_size);
+			out.put(',');
+			if (has_old) out.put_uint(d.old_cmp_size);
+			out.put(',');
+			if (has_new) out.put_uint(d.new_cmp_size);
+			out.put(',');
+			if (d.hashed) out.put_hex(d.old_hash);
+			out.put(',');
+			if (d.hashed) out.put_hex(d.new_hash);
+			out.put('\n');
+		}
+
+		out.row_done();
+	}
+
+	bool ok = out.flush();
+	if (close(fd)) {
+		ok = false;
+	}
+
+	return ok ? 0 : -1;
+}
+
+}
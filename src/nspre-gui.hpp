@@ -21,32 +21,531 @@
 #pragma once
 #include "imgui.h"
 #include "nspre.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 namespace ns {
 
 static const size_t INPUTTEXT_BUFFER_SIZE = 256;
 
+// Internal folder for files added on their own
+static const char PLACEHOLDER_PREFIX[] = "\\levels\\placeholder\\";
+
+// Memory the open archives' readers may use together, in MiB
+#ifndef NSPRE_GUI_MEMORY_BUDGET
+#define NSPRE_GUI_MEMORY_BUDGET 1024
+#endif
+
+// Submission queue entries for batched extraction output, 0 disables it
+#ifndef NSPRE_GUI_URING_DEPTH
+#define NSPRE_GUI_URING_DEPTH 64
+#endif
+
+// Extracted files of at least this many MiB bypass the page cache with
+// O_DIRECT, 0 disables it
+#ifndef NSPRE_GUI_DIRECT_IO
+#define NSPRE_GUI_DIRECT_IO 0
+#endif
+
+// Scratch buffers each thread keeps around for reuse, in MiB
+#ifndef NSPRE_GUI_BUFFER_CACHE
+#define NSPRE_GUI_BUFFER_CACHE 64
+#endif
+
 typedef std::vector<std::filesystem::path> PathList;
 typedef std::pair<std::filesystem::path,std::string> FileEntry;
 typedef std::pair<std::filesystem::directory_entry,bool> Selector;
 
+// Benchmark driver, see bench/ui_bench.cpp
+struct UiBench;
+
+// Location of one subfile inside a pre/prx, as stored on disk
+struct PreLayoutEntry {
+	std::string prepath;
+	uint32_t size = 0;
+	uint32_t cmp_size = 0;
+	uint32_t crc = 0;
+	uint64_t header_offset = 0;
+	uint64_t data_offset = 0;
+
+	bool stored() const { return cmp_size == 0 || cmp_size == size; }
+	uint32_t data_size() const { return stored() ? size : cmp_size; }
+};
+
+// Reads only the header and entry table of a pre/prx, skipping over the data
+class PreLayout {
+	std::vector<PreLayoutEntry> m_entries;
+	uint32_t m_version = 0;
+	uint64_t m_file_size = 0;
+public:
+	// With a callback, entries are passed to it (along with the total count)
+	// instead of being stored. Returning false from it stops reading.
+	bool read(const std::filesystem::path& path, const std::function<bool(const PreLayoutEntry&,uint32_t)>& on_entry = nullptr);
+	const std::vector<PreLayoutEntry>& entries() const { return m_entries; }
+	uint32_t version() const { return m_version; }
+	uint64_t file_size() const { return m_file_size; }
+};
+
+struct BufferPoolStats {
+	uint64_t takes = 0;
+	uint64_t reuses = 0;
+	uint64_t in_use = 0;
+	uint64_t peak_in_use = 0;
+	uint64_t cached = 0;
+	uint64_t peak_cached = 0;
+};
+
+// Scratch buffers for entry data, in power of two size classes from 4 KiB to
+// 64 MiB. Each thread keeps its own free lists, capped at
+// NSPRE_GUI_BUFFER_CACHE, so taking and giving back never locks. A buffer
+// may be given back on another thread than the one it came from. Counters
+// are shared across threads.
+class BufferPool {
+public:
+	static std::vector<char> take(size_t size);
+	static void give(std::vector<char>&& buffer);
+	// Resizes, trading the buffer for a pool one when it has to grow
+	static void fit(std::vector<char>& buffer, size_t size);
+	static BufferPoolStats stats();
+};
+
+// A pool buffer for the length of a scope
+struct PooledBuffer {
+	std::vector<char> data;
+
+	explicit PooledBuffer(size_t size) : data(BufferPool::take(size)) {}
+	PooledBuffer(const PooledBuffer&) = delete;
+	PooledBuffer& operator=(const PooledBuffer&) = delete;
+	~PooledBuffer() { BufferPool::give(std::move(data)); }
+};
+
+// Fast non-cryptographic 64 bit hash for telling entry contents apart
+class Hash64 {
+	uint64_t m_state = 0xcbf29ce484222325ull;
+	uint64_t m_length = 0;
+	unsigned char m_tail[8] = {};
+	size_t m_tail_size = 0;
+public:
+	void update(const void* data, size_t size);
+	uint64_t digest() const;
+};
+
+enum ManifestFormat {
+	MANIFEST_CSV,
+	MANIFEST_JSONL,
+	MANIFEST_BINARY
+};
+
+enum ManifestColumn {
+	MANIFEST_OFFSET = 1 << 0,
+	MANIFEST_RATIO = 1 << 1,
+	MANIFEST_HASH = 1 << 2
+};
+
+struct ManifestOptions {
+	int format = MANIFEST_CSV;
+	unsigned columns = 0;
+};
+
+struct LoadProgress {
+	std::vector<PreLayoutEntry> entries;
+	uint32_t total = 0;
+	bool done = false;
+	int error = 0;
+	std::unique_ptr<nspre::Reader> reader;
+};
+
+// Fixed set of threads shared by background jobs, started on first use.
+// Jobs are run in the order they were submitted.
+class WorkerPool {
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<std::function<void()>> m_jobs;
+	bool m_quit = false;
+
+	void run();
+public:
+	void submit(std::function<void()> job);
+	void run_parallel(const std::function<void()>& work);
+	unsigned threads();
+	void shutdown();
+	WorkerPool(){}
+	~WorkerPool();
+};
+
+extern WorkerPool worker_pool;
+
+// Opens archives on the worker pool. The entry table is parsed first and
+// handed over in batches so the table can fill in while nspre reads the
+// archive. A new open() or cancel() supersedes whatever is in flight.
+class ArchiveLoader {
+	struct State {
+		std::mutex mutex;
+		unsigned generation = 0;
+		LoadProgress progress;
+	};
+
+	// Shared with the running job, so the loader can go away before it ends
+	std::shared_ptr<State> m_state;
+
+	static void run(std::shared_ptr<State> state, unsigned generation, std::filesystem::path path, bool layout);
+public:
+	void open(const std::filesystem::path& path, bool layout = true);
+	void cancel();
+	void poll(LoadProgress& out);
+	ArchiveLoader();
+	~ArchiveLoader();
+};
+
+// One open archive in the extract window. The entry table stays resident
+// for as long as the tab is open, the reader can be dropped to stay under
+// the memory budget and is reopened when the tab is shown again.
+struct ArchiveTab {
+	std::filesystem::path path;
+	std::unique_ptr<nspre::Reader> reader;
+	std::vector<PreLayoutEntry> entries;
+	ArchiveLoader loader;
+	uint32_t total = 0;
+	uint64_t reader_bytes = 0;
+	int last_active = 0;
+	unsigned id = 0;
+	bool loading = false;
+	bool evicted = false;
+	std::vector<char> selected;
+	std::string focus;
+	int focus_row = -1;
+	bool scroll_to_focus = false;
+};
+
+struct ExtractStats {
+	uint64_t stored = 0;
+	uint64_t cloned = 0;
+	uint64_t decoded = 0;
+	uint64_t stored_bytes = 0;
+	uint64_t batched = 0;
+	uint64_t linked = 0;
+	uint64_t linked_bytes = 0;
+	uint64_t direct_io = 0;
+};
+
+// Creates, writes and closes output files through io_uring, a batch at a
+// time. Files are opened in one submission, then written and closed in a
+// second with each close linked to its write. init() fails on kernels
+// without io_uring or without the opcodes it needs.
+class UringWriter {
+	struct Ring;
+	struct Pending {
+		std::filesystem::path path;
+		std::vector<char> data;
+		int fd = -1;
+		int error = 0;
+		int64_t written = -1;
+		bool closed = false;
+	};
+
+	std::unique_ptr<Ring> m_ring;
+	std::vector<Pending> m_pending;
+	std::filesystem::path m_failed;
+	unsigned m_batch = 0;
+
+	int submit_and_wait(unsigned count);
+public:
+	bool init(unsigned depth);
+	int add(const std::filesystem::path& path, std::vector<char>&& data);
+	int flush();
+	const std::filesystem::path& failed_path() const { return m_failed; }
+	size_t queued() const { return m_pending.size(); }
+	UringWriter();
+	~UringWriter();
+};
+
+// Entries hinted to the kernel ahead of the one being extracted, per worker
+// thread reading the archive
+static const size_t PREFETCH_PER_WORKER = 4;
+
+// Extracts the entries of one open archive. Stored entries are copied from
+// the archive file straight into the output with a reflink or
+// copy_file_range, compressed ones go through nspre. Outputs written here
+// rather than by nspre are preallocated to their final size.
+class Extractor {
+	nspre::Reader& m_reader;
+	PreLayout m_layout;
+	int m_fd = -1;
+	uint64_t m_block_size = 0;
+	uint64_t m_archive_size = 0;
+	bool m_direct = false;
+	int m_memfd = -1;
+	uint64_t m_direct_io_min = 0;
+	char* m_aligned = nullptr;
+	size_t m_prefetch_window = 0;
+	size_t m_prefetched = 0;
+	std::unique_ptr<UringWriter> m_uring;
+	uint64_t m_uring_adds = 0;
+	std::filesystem::path m_failed;
+	ExtractStats m_stats;
+
+	// Outputs written so far by content hash, for use_dedup()
+	struct Written {
+		std::filesystem::path path;
+		uint64_t uring_seq = 0;
+		bool batched = false;
+	};
+	bool m_dedup = false;
+	std::multimap<uint64_t, Written> m_written;
+
+	bool decode(size_t index, uint64_t& size);
+	bool write_out(int out_fd, uint64_t size, int fd, uint64_t offset, const char* data);
+	int copy_stored(const PreLayoutEntry& e, const std::filesystem::path& out);
+	int copy_decoded(uint64_t size, const std::filesystem::path& out);
+	int write_file(const std::filesystem::path& out, const std::vector<char>& data);
+	bool link_duplicate(uint64_t digest, const std::vector<char>& data, const std::filesystem::path& out);
+	bool is_stored(size_t index);
+public:
+	Extractor(nspre::Reader& reader, const std::filesystem::path& archive);
+	Extractor(const Extractor&) = delete;
+	Extractor& operator=(const Extractor&) = delete;
+	~Extractor();
+	bool use_uring(unsigned depth);
+	void use_dedup(bool dedup) { m_dedup = dedup; }
+	void use_direct_io(uint64_t min_size) { m_direct_io_min = min_size; }
+	void use_prefetch(size_t window) { m_prefetch_window = window; }
+	std::vector<uint32_t> offset_order(const std::vector<uint32_t>* subset = nullptr) const;
+	void prefetch(const std::vector<uint32_t>& order, size_t pos);
+	bool read(size_t index, std::vector<char>& data);
+	int extract(size_t index, const std::filesystem::path& out);
+	int finish();
+	const std::filesystem::path& failed_path() const { return m_failed; }
+	const ExtractStats& stats() const { return m_stats; }
+};
+
+struct IndexedArchive {
+	std::string path;
+	uint64_t size = 0;
+	int64_t mtime_ns = 0;
+	uint32_t first_entry = 0;
+	uint32_t entries = 0;
+};
+
+struct IndexedEntry {
+	uint32_t archive = 0;
+	uint32_t size = 0;
+	uint32_t cmp_size = 0;
+	uint32_t name_size = 0;
+	uint64_t name_offset = 0;
+};
+
+// Internal paths of every archive under the scanned folders. Names are kept
+// in one newline separated block, plus a lowercase copy with '/' separators
+// that lookups run over.
+class ArchiveIndex {
+	std::string m_root;
+	std::vector<IndexedArchive> m_archives;
+	std::vector<IndexedEntry> m_entries;
+	std::string m_names;
+	std::string m_folded;
+public:
+	void set_root(const std::string& root) { m_root = root; }
+	const std::string& root() const { return m_root; }
+	void add_archive(const IndexedArchive& archive);
+	void add_entry(const std::string& name, uint32_t size, uint32_t cmp_size);
+	const std::vector<IndexedArchive>& archives() const { return m_archives; }
+	const std::vector<IndexedEntry>& entries() const { return m_entries; }
+	std::string name(uint32_t entry) const;
+	void search(const std::string& query, std::vector<uint32_t>& out, size_t limit) const;
+	bool load(const std::filesystem::path& path);
+	bool save(const std::filesystem::path& path) const;
+};
+
+struct IndexProgress {
+	std::shared_ptr<const ArchiveIndex> index;
+	uint32_t parsed = 0;
+	uint32_t total = 0;
+	bool scanning = false;
+	bool done = false;
+};
+
+// Loads, builds and saves the archive index on the worker pool. Entry tables
+// are parsed in parallel, archives whose size and mtime haven't changed
+// since the last scan are carried over without being read.
+class ArchiveIndexer {
+	struct State {
+		std::mutex mutex;
+		unsigned generation = 0;
+		IndexProgress progress;
+	};
+
+	std::shared_ptr<State> m_state;
+public:
+	void load(const std::filesystem::path& file);
+	void scan(const std::filesystem::path& root, std::shared_ptr<const ArchiveIndex> previous, const std::filesystem::path& file);
+	void cancel();
+	void poll(IndexProgress& out);
+	ArchiveIndexer();
+	~ArchiveIndexer();
+};
+
+enum DiffChange {
+	DIFF_UNCHANGED,
+	DIFF_ADDED,
+	DIFF_REMOVED,
+	DIFF_MODIFIED
+};
+
+// Hashes are of the decompressed contents and only filled in where they were
+// needed to tell two entries apart
+struct DiffEntry {
+	std::string prepath;
+	int change = DIFF_UNCHANGED;
+	uint32_t old_size = 0;
+	uint32_t new_size = 0;
+	uint32_t old_cmp_size = 0;
+	uint32_t new_cmp_size = 0;
+	uint64_t old_hash = 0;
+	uint64_t new_hash = 0;
+	bool hashed = false;
+};
+
+struct ArchiveDiff {
+	std::filesystem::path old_path;
+	std::filesystem::path new_path;
+	std::vector<DiffEntry> entries;
+	uint32_t added = 0;
+	uint32_t removed = 0;
+	uint32_t modified = 0;
+	uint32_t unchanged = 0;
+	uint32_t skipped = 0;
+	uint32_t decompressed = 0;
+};
+
+struct DiffProgress {
+	std::atomic<uint32_t> done{0};
+	std::atomic<uint32_t> total{0};
+};
+
+struct ArchiveInfo {
+	bool valid = false;
+	uint32_t entries = 0;
+	uint64_t size = 0;
+	uint64_t packed_size = 0;
+
+	float ratio() const { return size ? (float)packed_size / (float)size : 1.0f; }
+};
+
+struct ArchiveKey {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime_ns;
+
+	bool operator<(const ArchiveKey& k) const {
+		if (dev != k.dev) return dev < k.dev;
+		if (ino != k.ino) return ino < k.ino;
+		if (size != k.size) return size < k.size;
+		return mtime_ns < k.mtime_ns;
+	}
+};
+
+// Background worker that sniffs files for a valid pre/prx header and caches
+// what it finds by inode, size and mtime
+class ArchiveSniffer {
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::vector<std::filesystem::path> m_queue;
+	size_t m_queue_pos = 0;
+	unsigned m_generation = 0;
+	std::vector<std::pair<size_t,ArchiveInfo>> m_results;
+	std::map<ArchiveKey,ArchiveInfo> m_cache;
+	bool m_quit = false;
+
+	void run();
+public:
+	void request(const std::vector<std::filesystem::path>& paths);
+	void poll(std::vector<std::pair<size_t,ArchiveInfo>>& out);
+	ArchiveSniffer(){}
+	~ArchiveSniffer();
+};
+
+// Sort keys and stat results for one browser entry
+struct EntryMeta {
+	std::string name;
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	char mtime_text[20] = {};
+	bool stat_done = false;
+};
+
+struct StatResult {
+	size_t index;
+	uint64_t size;
+	int64_t mtime;
+	char mtime_text[20];
+};
+
+// Background worker that stats every entry of a directory once per scan
+class DirStatter {
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::filesystem::path m_dir;
+	std::vector<std::string> m_names;
+	bool m_pending = false;
+	unsigned m_generation = 0;
+	std::vector<StatResult> m_results;
+	bool m_quit = false;
+
+	void run();
+public:
+	void request(const std::filesystem::path& dir, std::vector<std::string> names);
+	void poll(std::vector<StatResult>& out);
+	DirStatter(){}
+	~DirStatter();
+};
+
+enum SortColumn {
+	SORT_NAME,
+	SORT_SIZE,
+	SORT_MTIME
+};
+
 class FileBrowserBase {
 protected:
 	std::filesystem::path m_current_path;
 	std::filesystem::path m_previous_path;
 	std::vector<Selector> m_dir_entries;
 	std::vector<Selector> m_file_entries;
+	std::vector<EntryMeta> m_dir_meta;
+	std::vector<EntryMeta> m_file_meta;
+	std::vector<int> m_dir_order;
+	std::vector<int> m_file_order;
+	std::vector<StatResult> m_stat_results;
+	DirStatter m_statter;
 	char m_fname_buffer[INPUTTEXT_BUFFER_SIZE + 1] = {};
 	bool m_show_hidden = false;
 	bool m_sort_ascending = true;
+	int m_sort_column = SORT_NAME;
 	bool valid_selection = false;
 	bool do_init = true;
 
 	int compare_strings(const std::string& s0, const std::string& s1);
 	void open_dir_base(std::filesystem::path path);
 	void show_top_region();
+	void sort_entries();
+	void setup_entry_columns();
+	void update_entries();
+	void show_entry_columns(const EntryMeta& meta, bool is_dir);
 	virtual void open_dir(const std::filesystem::path& path){}
 	virtual void single_click(std::vector<Selector>& v, int i){}
 	virtual void double_click(const std::vector<Selector>& v, int i){}
@@ -57,6 +556,8 @@ public:
 };
 
 class FileBrowserOpenMulti : FileBrowserBase {
+	friend struct UiBench;
+
 	ImGuiMultiSelectIO* msio;
 
 	void open_dir(const std::filesystem::path& path);
@@ -69,6 +570,11 @@ public:
 };
 
 class FileBrowserOpenOne : FileBrowserBase {
+	friend struct UiBench;
+
+	ArchiveSniffer m_sniffer;
+	std::vector<ArchiveInfo> m_archive_info;
+	std::vector<std::pair<size_t,ArchiveInfo>> m_sniff_results;
 	bool filter = true;
 
 	void open_dir(const std::filesystem::path& path);
@@ -80,6 +586,8 @@ public:
 };
 
 class FileBrowserSaveMulti : FileBrowserBase {
+	friend struct UiBench;
+
 	std::filesystem::path m_selected_path;
 
 	void open_dir(const std::filesystem::path& path);
@@ -91,6 +599,8 @@ public:
 };
 
 class FileBrowserSaveOne : FileBrowserBase {
+	friend struct UiBench;
+
 	std::filesystem::path& out_file;
 	bool& do_var;
 
@@ -108,62 +618,516 @@ class ExtractWindow {
 	FileBrowserOpenOne fb_open;
 	FileBrowserSaveMulti fb_saveall;
 	FileBrowserSaveOne fb_saveone;
-	nspre::Reader pre_reader;
-	std::filesystem::path in_file;
-	std::filesystem::path old_in_file;
+	FileBrowserSaveOne fb_savetar;
+	FileBrowserSaveOne fb_optimize;
+	std::vector<std::unique_ptr<ArchiveTab>> tabs;
+	int active_tab = -1;
+	int select_tab = -1;
+	unsigned next_tab_id = 0;
+	LoadProgress load_progress;
+	std::vector<FileEntry> open_queue;
 	std::filesystem::path out_dir;
-	std::filesystem::path csv_out;
-	bool do_open = false;
+	std::filesystem::path manifest_out;
+	std::filesystem::path tar_out;
+	std::filesystem::path optimize_out;
+	std::string optimize_report;
 	bool do_extract = false;
-	bool do_csv = false;
+	bool do_manifest = false;
+	bool do_tar = false;
+	bool do_optimize = false;
+	bool link_duplicates = false;
+	ManifestOptions manifest_options;
 
+	ArchiveTab* active();
 	void extract_files();
-	void int_export_csv();
-	void int_open_pre();
+	void int_extract_tar();
+	void int_optimize();
+	void int_export_manifest();
+	void int_open_pre(const std::filesystem::path& path, const std::string& focus);
+	bool poll_tab(ArchiveTab& tab);
+	bool show_tab(ArchiveTab& tab);
+	void close_tab(size_t index);
+	void enforce_budget();
 public:
 	ExtractWindow();
 	void show();
 	bool pre_is_open();
-	void open_pre(const std::filesystem::path& path);
+	void open_pre(const std::filesystem::path& path, const std::string& focus = "");
 	void extract_pre(const std::filesystem::path& path);
-	void export_csv(const std::filesystem::path& path);
+	void export_manifest(const std::filesystem::path& path);
 	void close_pre();
+	void close_all();
+};
+
+class IndexWindow {
+	ArchiveIndexer indexer;
+	IndexProgress progress;
+	std::shared_ptr<const ArchiveIndex> index;
+	std::vector<uint32_t> results;
+	char root_buffer[INPUTTEXT_BUFFER_SIZE + 1] = {};
+	char query_buffer[INPUTTEXT_BUFFER_SIZE + 1] = {};
+	double search_ms = 0.0;
+	int selected = -1;
+	bool scanning = false;
+	bool loaded = false;
+
+	void search();
+public:
+	void show(bool* open);
+};
+
+class DiffWindow {
+	struct Job {
+		ArchiveDiff diff;
+		DiffProgress progress;
+		std::atomic<bool> done{false};
+		int error = 0;
+	};
+
+	FileBrowserSaveOne fb_export;
+	std::shared_ptr<Job> job;
+	std::unique_ptr<ArchiveDiff> diff;
+	std::vector<uint32_t> rows;
+	char old_buffer[INPUTTEXT_BUFFER_SIZE + 1] = {};
+	char new_buffer[INPUTTEXT_BUFFER_SIZE + 1] = {};
+	std::filesystem::path export_out;
+	std::string status;
+	int export_format = MANIFEST_CSV;
+	bool do_export = false;
+	bool show_unchanged = false;
+
+	void compare();
+	void poll();
+	void filter();
+	void int_export();
+public:
+	DiffWindow();
+	void set_paths(const std::filesystem::path& old_path, const std::filesystem::path& new_path);
+	void show(bool* open);
+};
+
+struct FolderScanProgress {
+	std::vector<FileEntry> files;
+	uint32_t found = 0;
+	bool scanning = false;
+};
+
+// Walks dropped files and folders on the worker pool, one drop at a time,
+// and hands the files back in batches as they are found. Files inside a
+// folder get their path relative to that folder as the internal path.
+class FolderScanner {
+	struct Request {
+		std::filesystem::path path;
+		unsigned generation;
+	};
+	struct State {
+		std::mutex mutex;
+		unsigned generation = 0;
+		std::deque<Request> queue;
+		bool running = false;
+		FolderScanProgress progress;
+	};
+
+	std::shared_ptr<State> m_state;
+
+	static void run(std::shared_ptr<State> state);
+public:
+	void add(const PathList& paths);
+	void cancel();
+	void poll(FolderScanProgress& out);
+	FolderScanner();
+	~FolderScanner();
+};
+
+// With auto_store, inputs whose sampled byte entropy says they would only
+// shrink to store_ratio of their size or worse are stored as is
+struct PackOptions {
+	bool auto_store = false;
+	float store_ratio = 0.95f;
+};
+
+struct PackStats {
+	uint64_t stored = 0;
+	uint64_t compressed = 0;
+	uint64_t reused = 0;
+	uint64_t bytes_in = 0;
+	uint64_t bytes_out = 0;
+};
+
+// Where each entry of the last archive built with it ended up, so a rebuild
+// can copy the ones whose source hasn't changed straight out of it. Only
+// trusted while the archive's size and mtime are what they were after the
+// build, and the pack options haven't changed.
+struct PackCacheEntry {
+	uint64_t size = 0;
+	int64_t mtime_ns = 0;
+	uint64_t offset = 0;
+	uint64_t length = 0;
+	bool stored = false;
+};
+
+struct PackCache {
+	std::filesystem::path archive;
+	uint64_t archive_size = 0;
+	int64_t archive_mtime_ns = 0;
+	uint32_t version = 0;
+	PackOptions options;
+	std::map<std::string,PackCacheEntry> entries;
+};
+
+struct OptimizeStats {
+	uint32_t entries = 0;
+	uint32_t improved = 0;
+	uint64_t bytes_before = 0;
+	uint64_t bytes_after = 0;
+	float ms = 0.0f;
+};
+
+#ifndef NSPRE_GUI_WATCH_DEBOUNCE_MS
+#define NSPRE_GUI_WATCH_DEBOUNCE_MS 150
+#endif
+
+struct WatchStatus {
+	bool watching = false;
+	unsigned builds = 0;
+	int error = 0;
+	std::string failed;
+	float build_ms = 0.0f;
+	PackStats stats;
+};
+
+// Rebuilds an archive whenever one of its inputs changes, once changes have
+// stopped coming in for NSPRE_GUI_WATCH_DEBOUNCE_MS. The folders holding the
+// inputs are watched rather than the files themselves, since editors tend
+// to save by writing a new file and renaming it over the old one. Entries
+// whose source hasn't changed are copied from the previous build.
+class ArchiveWatcher {
+	std::thread m_thread;
+	std::mutex m_mutex;
+	WatchStatus m_status;
+	int m_wake = -1;
+	std::vector<nspre::Subfile> m_subfiles;
+	std::filesystem::path m_out;
+	PackOptions m_options;
+
+	void run(int inotify);
+	void build(PackCache& cache);
+public:
+	bool start(const std::vector<nspre::Subfile>& subfiles, const std::filesystem::path& out, const PackOptions& options);
+	void stop();
+	WatchStatus status();
+	ArchiveWatcher(){}
+	~ArchiveWatcher();
+};
+
+// Sampled bytes of an input and what they compressed to. Exact once the
+// whole file went through the encoder in one piece.
+struct SizeEstimate {
+	uint64_t size = 0;
+	uint64_t sampled = 0;
+	uint64_t compressed = 0;
+	bool exact = false;
+
+	uint64_t estimate() const;
+	bool known() const { return sampled || exact; }
+};
+
+// Inputs of the create window, one array per column. Source paths and
+// internal paths are NUL terminated strings in one arena that rows point
+// into, replaced strings are left behind until there is enough garbage to
+// compact. Empty internal paths and selected rows are counted as they
+// change so the window never has to walk the list to find out.
+class CreateList {
+	std::vector<char> m_arena;
+	std::vector<uint32_t> m_source;
+	std::vector<uint32_t> m_name;
+	std::vector<uint32_t> m_ipath;
+	std::vector<char> m_selected;
+	std::vector<uint32_t> m_id;
+	std::vector<SizeEstimate> m_estimate;
+	uint32_t m_next_id = 0;
+	uint64_t m_estimated_bytes = 0;
+	uint64_t m_ipath_bytes = 0;
+	size_t m_estimated = 0;
+	size_t m_empty = 0;
+	size_t m_selected_count = 0;
+	size_t m_garbage = 0;
+
+	uint32_t store(const char* str, size_t size);
+	void compact();
+	void remove_rows(size_t first, bool selected_only, std::vector<uint32_t>& removed);
+public:
+	size_t size() const { return m_source.size(); }
+	bool ready() const { return size() && !m_empty; }
+	size_t selected_count() const { return m_selected_count; }
+	size_t estimated_count() const { return m_estimated; }
+	const char* source(size_t i) const { return m_arena.data() + m_source[i]; }
+	const char* filename(size_t i) const { return m_arena.data() + m_name[i]; }
+	const char* ipath(size_t i) const { return m_arena.data() + m_ipath[i]; }
+	bool selected(size_t i) const { return m_selected[i]; }
+	uint32_t id(size_t i) const { return m_id[i]; }
+	const SizeEstimate& estimate(size_t i) const { return m_estimate[i]; }
+	int64_t find(uint32_t id) const;
+	uint64_t projected_size() const;
+	uint32_t add(const std::filesystem::path& source, const std::string& ipath);
+	void set_estimate(size_t i, const SizeEstimate& estimate);
+	void set_ipath(size_t i, const std::string& ipath);
+	void select(size_t i, bool selected);
+	void select_all(bool selected);
+	void remove(size_t i, std::vector<uint32_t>& removed);
+	void remove_selected(std::vector<uint32_t>& removed);
+	void clear();
+};
+
+// Estimates how well the create list will compress by running samples of
+// each input through nspre's encoder on the worker pool. Every input gets
+// one sample before any gets a second, so the estimates start out rough and
+// refine the longer the list sits there. Each pool job takes one sample and
+// queues the next behind whatever else was submitted meanwhile.
+class SizeEstimator {
+	struct Input {
+		uint32_t id;
+		std::filesystem::path path;
+		SizeEstimate estimate;
+		unsigned samples = 0;
+	};
+	struct State {
+		std::mutex mutex;
+		unsigned generation = 0;
+		std::deque<Input> queue;
+		std::vector<std::pair<uint32_t,SizeEstimate>> updates;
+		unsigned running = 0;
+	};
+
+	std::shared_ptr<State> m_state;
+
+	static void run(std::shared_ptr<State> state, unsigned generation);
+public:
+	void add(uint32_t id, const std::filesystem::path& path);
+	void remove(const std::vector<uint32_t>& ids);
+	void cancel();
+	bool busy();
+	void poll(std::vector<std::pair<uint32_t,SizeEstimate>>& out);
+	SizeEstimator();
+	~SizeEstimator();
+};
+
+// Held while a save or optimize wants every core. Estimates stop taking new
+// samples until the last one is released.
+class EstimatorPause {
+public:
+	EstimatorPause();
+	EstimatorPause(const EstimatorPause&) = delete;
+	EstimatorPause& operator=(const EstimatorPause&) = delete;
+	~EstimatorPause();
 };
 
 class CreateWindow {
+	friend struct UiBench;
+
 	FileBrowserSaveOne fb_save;
 	FileBrowserOpenMulti fb_openmulti;
 	std::filesystem::path out_file;
 	char ipath_buffer[INPUTTEXT_BUFFER_SIZE + 1] = {};
-	std::vector<FileEntry> files;
+	CreateList files;
+	FolderScanner scanner;
+	FolderScanProgress scan_progress;
+	SizeEstimator estimator;
+	std::vector<std::pair<uint32_t,SizeEstimate>> estimates;
+	std::vector<uint32_t> removed_ids;
+	PackOptions pack_options;
+	ArchiveWatcher watcher;
 	int edit_index = -1;
 	bool do_create = false;
+	bool watch_after_save = false;
 	bool edit_init = true;
 
 	void create_pre();
-	bool files_ready();
+	void start_watch();
 	void edit_popup();
+	void apply_selection(ImGuiMultiSelectIO* msio);
+	void add_file(const std::filesystem::path& path, const std::string& ipath);
 public:
 	CreateWindow();
 	~CreateWindow(){}
 	void show();
 	void drop_files(const PathList& pathlist);
 	void drop_file(const std::filesystem::path& path);
+	void drop_folder(const std::filesystem::path& path);
+};
+
+static const int PROFILER_FRAMES = 240;
+static const int PROFILER_MAX_SCOPES = 32;
+
+struct ProfileStat {
+	const char* name = 0;
+	float last_ms = 0.0f;
+	float avg_ms = 0.0f;
+	float max_ms = 0.0f;
+	uint64_t count = 0;
+};
+
+// Collects scope timings for the overlay and optionally streams them to a
+// Chrome trace-event file that can be loaded in Perfetto
+class Profiler {
+	std::mutex m_mutex;
+	std::atomic<bool> m_enabled{false};
+	std::FILE* m_trace = 0;
+	bool m_first_event = true;
+	uint64_t m_epoch;
+	float m_frame_ms[PROFILER_FRAMES] = {};
+	int m_frame_pos = 0;
+	int m_frame_count = 0;
+	ProfileStat m_stats[PROFILER_MAX_SCOPES];
+	int m_stat_count = 0;
+	bool m_overlay = false;
+public:
+	static uint64_t now_ns();
+	bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+	bool start_trace(const std::filesystem::path& path);
+	void end_trace();
+	void set_overlay(bool show);
+	void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+	void frame(uint64_t start_ns, uint64_t end_ns);
+	void show(bool* open);
+	Profiler();
+	~Profiler();
+};
+
+extern Profiler profiler;
+
+class ProfileScope {
+	const char* m_name;
+	uint64_t m_start;
+public:
+	ProfileScope(const char* name) : m_name(name), m_start(profiler.enabled() ? Profiler::now_ns() : 0) {}
+	~ProfileScope() { if (m_start) profiler.record(m_name, m_start, Profiler::now_ns()); }
+};
+
+#define NS_PROFILE_CONCAT_(a,b) a##b
+#define NS_PROFILE_CONCAT(a,b) NS_PROFILE_CONCAT_(a,b)
+#define NS_PROFILE_SCOPE(name) ns::ProfileScope NS_PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+enum {
+	METRICS_JSONL,
+	METRICS_PROMETHEUS,
+};
+
+// Operations kept for the Operations window
+static const size_t OPERATION_LOG_SIZE = 256;
+
+// Resource use of one open, extract, export or create. Operations that run
+// on a single thread count CPU time and bytes for that thread, the rest for
+// the whole process, so anything running alongside is counted too. Peak RSS
+// and allocations, buffers the pool couldn't reuse, are always process-wide.
+struct OperationRecord {
+	std::string name;
+	std::string target;
+	bool ok = true;
+	bool thread_scope = false;
+	int64_t start_unix_ms = 0;
+	double wall_ms = 0;
+	double cpu_ms = 0;
+	uint64_t bytes_read = 0;
+	uint64_t bytes_written = 0;
+	uint64_t entries = 0;
+	uint64_t peak_rss = 0;
+	uint64_t allocations = 0;
+
+	double entries_per_s() const { return wall_ms > 0 ? entries * 1000.0 / wall_ms : 0; }
+	const char* scope() const { return thread_scope ? "thread" : "process"; }
+};
+
+// Takes a snapshot of the counters when created, finish() hands the
+// difference to the operation log. With thread_scope it has to be finished
+// on the thread that created it. Peak RSS is only reset when no other timer
+// is running, so overlapping operations don't wipe each other's peak.
+class OperationTimer {
+	OperationRecord m_record;
+	uint64_t m_start_ns;
+	uint64_t m_cpu_ns;
+	uint64_t m_read;
+	uint64_t m_written;
+	uint64_t m_allocations;
+	bool m_finished = false;
+public:
+	void finish(uint64_t entries, bool ok = true);
+	OperationTimer(const char* name, const std::filesystem::path& target, bool thread_scope = false);
+	OperationTimer(const OperationTimer&) = delete;
+	OperationTimer& operator=(const OperationTimer&) = delete;
+	~OperationTimer();
 };
 
+// Every operation goes to the Operations window. With a metrics file set
+// they are also appended to it as JSON Lines, or a Prometheus textfile with
+// running totals per operation is rewritten.
+class OperationLog {
+	struct Totals {
+		uint64_t count = 0;
+		uint64_t failed = 0;
+		double wall_ms = 0;
+		double cpu_ms = 0;
+		uint64_t bytes_read = 0;
+		uint64_t bytes_written = 0;
+		uint64_t entries = 0;
+		uint64_t allocations = 0;
+		uint64_t peak_rss = 0;
+	};
+
+	std::mutex m_mutex;
+	std::deque<OperationRecord> m_records;
+	std::map<std::pair<std::string,std::string>,Totals> m_totals;
+	std::filesystem::path m_path;
+	int m_format = METRICS_JSONL;
+	std::FILE* m_file = 0;
+
+	bool write_prometheus();
+public:
+	bool open(const std::filesystem::path& path, int format);
+	void add(OperationRecord&& record);
+	void show(bool* open);
+	~OperationLog();
+};
+
+extern OperationLog operation_log;
+
 struct GlobalStruct {
 	ImGuiIO* io;
 	std::stringstream error_modal_text;
 	bool show_demo_window = false;
 	bool show_debug = false;
+	bool show_profiler = false;
+	bool show_operations = false;
+	bool show_index = false;
+	bool show_diff = false;
 	bool open_mode = true;
+	uint64_t memory_budget = (uint64_t)NSPRE_GUI_MEMORY_BUDGET << 20;
+	unsigned uring_depth = NSPRE_GUI_URING_DEPTH;
+	uint64_t direct_io_min = (uint64_t)NSPRE_GUI_DIRECT_IO << 20;
 	bool quit = false;
 };
 
 extern GlobalStruct global;
 extern ExtractWindow extract_window;
 extern CreateWindow create_window;
+extern IndexWindow index_window;
+extern DiffWindow diff_window;
 
 void open_pre(const std::filesystem::path& path);
 void popup_proc();
+void request_redraw();
+const char* manifest_extension(int format);
+int write_manifest(nspre::Reader& reader, const std::filesystem::path& archive, const std::filesystem::path& path, const ManifestOptions& options);
+void format_size(char* buf, size_t buf_size, uint64_t size);
+std::filesystem::path index_file();
+bool hash_entry(int fd, const PreLayoutEntry& e, std::vector<char>& buf, uint64_t& hash);
+int diff_archives(ArchiveDiff& diff, DiffProgress* progress = nullptr);
+int write_diff(const ArchiveDiff& diff, const std::filesystem::path& path, int format, bool unchanged);
+const char* diff_change_name(int change);
+int write_pre(const std::vector<nspre::Subfile>& subfiles, const std::filesystem::path& path, const PackOptions& options, PackStats* stats = nullptr, PackCache* cache = nullptr);
+int rebuild_pre(const std::vector<nspre::Subfile>& subfiles, const std::filesystem::path& path, const PackOptions& options, PackCache& cache, PackStats* stats = nullptr);
+std::string folder_internal_path(const std::filesystem::path& relative);
+int optimize_pre(const std::filesystem::path& in, const std::filesystem::path& out, OptimizeStats& stats);
+std::string tar_path(const std::string& prepath);
+int write_tar(nspre::Reader& reader, const std::filesystem::path& archive, const std::filesystem::path& path, const std::vector<uint32_t>* subset = nullptr, std::string* failed = nullptr);
 }
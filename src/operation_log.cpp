@@ -0,0 +1,374 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include "imgui.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+OperationLog operation_log;
+
+// Timers running right now, peak RSS is only reset when there are none
+static std::atomic<unsigned> s_active{0};
+
+static uint64_t cpu_ns(bool thread) {
+	timespec ts;
+	if (clock_gettime(thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID, &ts)) {
+		return 0;
+	}
+
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Bytes passed through read and write calls of any kind, so page cache hits
+// count as well
+static void io_bytes(bool thread, uint64_t& read, uint64_t& written) {
+	read = 0;
+	written = 0;
+	std::FILE* f = std::fopen(thread ? "/proc/thread-self/io" : "/proc/self/io", "r");
+	if (!f) {
+		return;
+	}
+
+	char line[128];
+	unsigned long long value;
+	while (std::fgets(line, sizeof(line), f)) {
+		if (std::sscanf(line, "rchar: %llu", &value) == 1) {
+			read = value;
+		}
+		else if (std::sscanf(line, "wchar: %llu", &value) == 1) {
+			written = value;
+		}
+	}
+	std::fclose(f);
+}
+
+// Peak RSS since reset_peak_rss(), or since the start of the process on
+// kernels that can't reset it
+static uint64_t peak_rss() {
+	std::FILE* f = std::fopen("/proc/self/status", "r");
+	if (!f) {
+		return 0;
+	}
+
+	char line[128];
+	unsigned long long kib = 0;
+	while (std::fgets(line, sizeof(line), f)) {
+		if (std::sscanf(line, "VmHWM: %llu kB", &kib) == 1) {
+			break;
+		}
+	}
+	std::fclose(f);
+	return (uint64_t)kib << 10;
+}
+
+static void reset_peak_rss() {
+	std::FILE* f = std::fopen("/proc/self/clear_refs", "w");
+	if (f) {
+		std::fputs("5", f);
+		std::fclose(f);
+	}
+}
+
+static uint64_t pool_allocations() {
+	BufferPoolStats pool = BufferPool::stats();
+	return pool.takes - pool.reuses;
+}
+
+OperationTimer::OperationTimer(const char* name, const fs::path& target, bool thread_scope) {
+	m_record.name = name;
+	m_record.target = target.string();
+	m_record.thread_scope = thread_scope;
+	m_record.start_unix_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	if (s_active++ == 0) {
+		reset_peak_rss();
+	}
+	io_bytes(thread_scope, m_read, m_written);
+	m_allocations = pool_allocations();
+	m_cpu_ns = cpu_ns(thread_scope);
+	m_start_ns = Profiler::now_ns();
+}
+
+// Superseded operations are dropped without a record
+OperationTimer::~OperationTimer() {
+	if (!m_finished) {
+		--s_active;
+	}
+}
+
+void OperationTimer::finish(uint64_t entries, bool ok) {
+	if (m_finished) {
+		return;
+	}
+	m_finished = true;
+	--s_active;
+
+	bool thread = m_record.thread_scope;
+	m_record.wall_ms = (Profiler::now_ns() - m_start_ns) / 1000000.0;
+	m_record.cpu_ms = (cpu_ns(thread) - m_cpu_ns) / 1000000.0;
+	uint64_t read;
+	uint64_t written;
+	io_bytes(thread, read, written);
+	m_record.bytes_read = read - m_read;
+	m_record.bytes_written = written - m_written;
+	m_record.allocations = pool_allocations() - m_allocations;
+	m_record.peak_rss = peak_rss();
+	m_record.entries = entries;
+	m_record.ok = ok;
+	operation_log.add(std::move(m_record));
+}
+
+static void put_json(std::string& out, const std::string& s) {
+	out.push_back('"');
+	for (unsigned char c : s) {
+		if (c == '"' || c == '\\') {
+			out.push_back('\\');
+			out.push_back(c);
+		}
+		else if (c < 0x20) {
+			char tmp[8];
+			std::snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+			out.append(tmp);
+		}
+		else {
+			out.push_back(c);
+		}
+	}
+	out.push_back('"');
+}
+
+// Prometheus textfiles are rewritten whole, the rest is appended to
+bool OperationLog::open(const fs::path& path, int format) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_path = path;
+	m_format = format;
+	if (format == METRICS_PROMETHEUS) {
+		if (!write_prometheus()) {
+			m_path.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	m_file = std::fopen(path.c_str(), "a");
+	if (!m_file) {
+		m_path.clear();
+		return false;
+	}
+
+	return true;
+}
+
+// Totals only, a textfile collector reads the file on every scrape and a
+// rename keeps it from seeing half of one
+bool OperationLog::write_prometheus() {
+	static const struct {
+		const char* name;
+		const char* type;
+		const char* help;
+	} metrics[] = {
+		{"nspre_gui_operations_total", "counter", "Operations run"},
+		{"nspre_gui_operation_failures_total", "counter", "Operations that failed"},
+		{"nspre_gui_operation_wall_seconds_total", "counter", "Wall time spent in operations"},
+		{"nspre_gui_operation_cpu_seconds_total", "counter", "CPU time spent in operations, of the thread or the process as the scope label says"},
+		{"nspre_gui_operation_read_bytes_total", "counter", "Bytes read during operations, by the thread or the process as the scope label says"},
+		{"nspre_gui_operation_written_bytes_total", "counter", "Bytes written during operations, by the thread or the process as the scope label says"},
+		{"nspre_gui_operation_entries_total", "counter", "Archive entries handled by operations"},
+		{"nspre_gui_operation_allocations_total", "counter", "Buffers allocated by the process during operations"},
+		{"nspre_gui_operation_peak_rss_bytes", "gauge", "Highest process peak RSS seen during an operation"},
+	};
+
+	std::string out;
+	char line[512];
+	for (size_t m = 0; m < sizeof(metrics) / sizeof(metrics[0]); ++m) {
+		std::snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", metrics[m].name, metrics[m].help, metrics[m].name, metrics[m].type);
+		out.append(line);
+		for (auto& it : m_totals) {
+			const Totals& t = it.second;
+			double values[] = {
+				(double)t.count, (double)t.failed, t.wall_ms / 1000.0, t.cpu_ms / 1000.0, (double)t.bytes_read,
+				(double)t.bytes_written, (double)t.entries, (double)t.allocations, (double)t.peak_rss,
+			};
+			std::snprintf(line, sizeof(line), "%s{operation=\"%s\",scope=\"%s\"} %.10g\n", metrics[m].name,
+				it.first.first.c_str(), it.first.second.c_str(), values[m]);
+			out.append(line);
+		}
+	}
+
+	fs::path tmp = m_path;
+	tmp += ".tmp";
+	std::FILE* f = std::fopen(tmp.c_str(), "w");
+	if (!f) {
+		return false;
+	}
+
+	bool ok = std::fwrite(out.data(), 1, out.size(), f) == out.size();
+	ok = (std::fclose(f) == 0) && ok;
+	std::error_code ec;
+	if (ok) {
+		fs::rename(tmp, m_path, ec);
+	}
+	if (!ok || ec) {
+		fs::remove(tmp, ec);
+		return false;
+	}
+
+	return true;
+}
+
+void OperationLog::add(OperationRecord&& record) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Totals& t = m_totals[{record.name, record.scope()}];
+	++t.count;
+	t.failed += !record.ok;
+	t.wall_ms += record.wall_ms;
+	t.cpu_ms += record.cpu_ms;
+	t.bytes_read += record.bytes_read;
+	t.bytes_written += record.bytes_written;
+	t.entries += record.entries;
+	t.allocations += record.allocations;
+	t.peak_rss = std::max(t.peak_rss, record.peak_rss);
+
+	if (m_file) {
+		std::string out = "{\"operation\":";
+		put_json(out, record.name);
+		out += ",\"target\":";
+		put_json(out, record.target);
+		out += ",\"scope\":\"";
+		out += record.scope();
+		out += "\"";
+		char tmp[512];
+		std::snprintf(tmp, sizeof(tmp),
+			",\"ok\":%s,\"start_unix_ms\":%lld,\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"bytes_read\":%llu,\"bytes_written\":%llu,"
+			"\"entries\":%llu,\"entries_per_s\":%.1f,\"peak_rss\":%llu,\"allocations\":%llu}\n",
+			record.ok ? "true" : "false", (long long)record.start_unix_ms, record.wall_ms, record.cpu_ms,
+			(unsigned long long)record.bytes_read, (unsigned long long)record.bytes_written, (unsigned long long)record.entries,
+			record.entries_per_s(), (unsigned long long)record.peak_rss, (unsigned long long)record.allocations);
+		out += tmp;
+		std::fwrite(out.data(), 1, out.size(), m_file);
+		std::fflush(m_file);
+	}
+	else if (!m_path.empty() && m_format == METRICS_PROMETHEUS && !write_prometheus()) {
+		std::fprintf(stderr, "can't write metrics to \"%s\"\n", m_path.c_str());
+	}
+
+	m_records.push_back(std::move(record));
+	if (m_records.size() > OPERATION_LOG_SIZE) {
+		m_records.pop_front();
+	}
+	request_redraw();
+}
+
+void OperationLog::show(bool* open) {
+	if (!*open) {
+		return;
+	}
+
+	ImGui::SetNextWindowSize({720, 260}, ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Operations", open)) {
+		ImGui::End();
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (ImGui::SmallButton("Clear")) {
+		m_records.clear();
+	}
+	if (!m_path.empty()) {
+		ImGui::SameLine();
+		ImGui::TextDisabled("Metrics written to \"%s\"", m_path.c_str());
+	}
+
+	ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Resizable;
+	if (ImGui::BeginTable("operations", 10, flags)) {
+		ImGui::TableSetupScrollFreeze(0, 1);
+		ImGui::TableSetupColumn("Operation");
+		ImGui::TableSetupColumn("Target");
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("Wall (ms)");
+		ImGui::TableSetupColumn("CPU (ms)");
+		ImGui::TableSetupColumn("Read");
+		ImGui::TableSetupColumn("Written");
+		ImGui::TableSetupColumn("Entries/s");
+		ImGui::TableSetupColumn("Peak RSS");
+		ImGui::TableSetupColumn("Allocs");
+		ImGui::TableHeadersRow();
+
+		// Newest first
+		char size[32];
+		for (auto it = m_records.rbegin(); it != m_records.rend(); ++it) {
+			const OperationRecord& r = *it;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			if (r.ok) {
+				ImGui::Text("%s", r.name.c_str());
+			}
+			else {
+				ImGui::TextDisabled("%s (failed)", r.name.c_str());
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", fs::path(r.target).filename().c_str());
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip("%s", r.target.c_str());
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", r.scope());
+			if (ImGui::IsItemHovered()) {
+				ImGui::SetTooltip(r.thread_scope ? "CPU and bytes of the thread it ran on" : "CPU and bytes of the whole process, including anything running alongside");
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", r.wall_ms);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", r.cpu_ms);
+			ImGui::TableNextColumn();
+			format_size(size, sizeof(size), r.bytes_read);
+			ImGui::Text("%s", size);
+			ImGui::TableNextColumn();
+			format_size(size, sizeof(size), r.bytes_written);
+			ImGui::Text("%s", size);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.0f", r.entries_per_s());
+			ImGui::TableNextColumn();
+			// Process-wide whatever the scope
+			format_size(size, sizeof(size), r.peak_rss);
+			ImGui::Text("%s", size);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)r.allocations);
+		}
+
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
+
+OperationLog::~OperationLog() {
+	if (m_file) {
+		std::fclose(m_file);
+	}
+}
+
+}
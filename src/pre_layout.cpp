@@ -0,0 +1,131 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <cstdio>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+static uint32_t read_u32(const unsigned char* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Header is u32 file size, u32 version, u32 file count. Each entry is u32 size,
+// u32 compressed size (0 if stored), u32 name length, u32 name crc, the name,
+// then the data padded to 4 bytes. The file size has to match and the entries
+// have to end exactly at the end of the file for it to count as a pre/prx.
+bool PreLayout::read(const std::filesystem::path& path, const std::function<bool(const PreLayoutEntry&,uint32_t)>& on_entry) {
+	m_entries.clear();
+	m_version = 0;
+	m_file_size = 0;
+
+	std::error_code ec;
+	uint64_t actual_size = fs::file_size(path, ec);
+	if (ec || actual_size < 12) {
+		return false;
+	}
+
+	std::FILE* f = std::fopen(path.c_str(), "rb");
+	if (!f) {
+		return false;
+	}
+
+	unsigned char buf[16];
+	if (std::fread(buf, 1, 12, f) != 12) {
+		std::fclose(f);
+		return false;
+	}
+
+	uint64_t stated_size = read_u32(buf);
+	uint32_t version = read_u32(buf + 4);
+	uint32_t count = read_u32(buf + 8);
+
+	// A pre/prx needs at least 16 bytes per entry
+	if (stated_size != actual_size || count == 0 || count > (actual_size - 12) / 16) {
+		std::fclose(f);
+		return false;
+	}
+
+	std::vector<PreLayoutEntry> entries;
+	if (!on_entry) {
+		entries.reserve(count);
+	}
+	uint64_t offset = 12;
+	std::string name;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		if (offset + 16 > actual_size || std::fseek(f, offset, SEEK_SET) || std::fread(buf, 1, 16, f) != 16) {
+			std::fclose(f);
+			return false;
+		}
+
+		PreLayoutEntry e;
+		e.header_offset = offset;
+		e.size = read_u32(buf);
+		e.cmp_size = read_u32(buf + 4);
+		uint32_t name_len = read_u32(buf + 8);
+		e.crc = read_u32(buf + 12);
+
+		if (name_len == 0 || offset + 16 + name_len > actual_size) {
+			std::fclose(f);
+			return false;
+		}
+
+		name.resize(name_len);
+		if (std::fread(name.data(), 1, name_len, f) != name_len) {
+			std::fclose(f);
+			return false;
+		}
+
+		e.prepath.assign(name.c_str());
+		e.data_offset = offset + 16 + name_len;
+		offset = e.data_offset + ((e.data_size() + 3) & ~(uint64_t)3);
+
+		if (e.data_offset + e.data_size() > actual_size) {
+			std::fclose(f);
+			return false;
+		}
+
+		if (on_entry) {
+			if (!on_entry(e, count)) {
+				std::fclose(f);
+				return false;
+			}
+		}
+		else {
+			entries.push_back(std::move(e));
+		}
+	}
+
+	std::fclose(f);
+
+	if (offset < actual_size - 3 || offset > actual_size + 3) {
+		return false;
+	}
+
+	m_entries = std::move(entries);
+	m_version = version;
+	m_file_size = actual_size;
+	return true;
+}
+
+}
@@ -0,0 +1,619 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+static const uint64_t PROBE_CHUNK = 16 << 10;
+static const unsigned PROBE_CHUNKS = 4;
+
+// Entries packed ahead of the one being written, per pool thread
+static const size_t PACK_WINDOW = 4;
+
+static uint32_t get_u32(const char* p) {
+	const unsigned char* u = (const unsigned char*)p;
+	return (uint32_t)u[0] | ((uint32_t)u[1] << 8) | ((uint32_t)u[2] << 16) | ((uint32_t)u[3] << 24);
+}
+
+static void put_u32(char* p, uint32_t v) {
+	p[0] = v & 0xff;
+	p[1] = (v >> 8) & 0xff;
+	p[2] = (v >> 16) & 0xff;
+	p[3] = (v >> 24) & 0xff;
+}
+
+// Order-0 entropy in bits per byte of a few chunks spread over the file,
+// read with pread so the probe never touches the rest of it. Compressed
+// audio, video and images come out close to 8. Negative on a read error.
+static double sample_entropy(int fd, uint64_t size) {
+	uint64_t counts[256] = {};
+	uint64_t total = 0;
+	unsigned char chunk[PROBE_CHUNK];
+	auto count = [&](uint64_t offset, size_t length) {
+		size_t done = 0;
+		while (done < length) {
+			ssize_t n = pread(fd, chunk + done, length - done, offset + done);
+			if (n <= 0) {
+				return false;
+			}
+			done += n;
+		}
+		for (size_t i = 0; i < length; ++i) {
+			++counts[chunk[i]];
+		}
+		total += length;
+		return true;
+	};
+
+	if (size <= PROBE_CHUNK * PROBE_CHUNKS) {
+		for (uint64_t offset = 0; offset < size; offset += PROBE_CHUNK) {
+			if (!count(offset, std::min(PROBE_CHUNK, size - offset))) {
+				return -1.0;
+			}
+		}
+	}
+	else {
+		for (unsigned i = 0; i < PROBE_CHUNKS; ++i) {
+			if (!count((size - PROBE_CHUNK) * i / (PROBE_CHUNKS - 1), PROBE_CHUNK)) {
+				return -1.0;
+			}
+		}
+	}
+
+	double entropy = 0.0;
+	for (uint64_t c : counts) {
+		if (c) {
+			double p = (double)c / total;
+			entropy -= p * std::log2(p);
+		}
+	}
+
+	return entropy;
+}
+
+static bool read_all(int fd, std::vector<char>& data, uint64_t size) {
+	BufferPool::fit(data, size);
+	size_t done = 0;
+	while (done < data.size()) {
+		ssize_t n = pread(fd, data.data() + done, data.size() - done, done);
+		if (n <= 0) {
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+// Builds single entries by having nspre write a one entry archive into a
+// memfd and taking the entry back out of it. Stored entries reuse the
+// header nspre writes for an empty file, so the name and its checksum are
+// exactly what nspre would have written.
+struct EntryPacker {
+	int out_fd = -1;
+	int empty_fd = -1;
+	std::vector<char> archive;
+
+	bool nspre_entry(const fs::path& source, const std::string& prepath, std::vector<char>& entry, uint32_t& version) {
+		if (out_fd < 0) {
+			out_fd = memfd_create("nspre-pack", MFD_CLOEXEC);
+		}
+		if (out_fd < 0 || ftruncate(out_fd, 0)) {
+			return false;
+		}
+
+		std::vector<nspre::Subfile> subfiles;
+		subfiles.push_back({source, prepath});
+		if (nspre::write(subfiles, "/proc/self/fd/" + std::to_string(out_fd))) {
+			return false;
+		}
+
+		struct stat st;
+		if (fstat(out_fd, &st) || st.st_size < 28) {
+			return false;
+		}
+		archive.resize(st.st_size);
+		if (pread(out_fd, archive.data(), archive.size(), 0) != (ssize_t)archive.size()) {
+			return false;
+		}
+
+		version = get_u32(archive.data() + 4);
+		entry.assign(archive.begin() + 12, archive.end());
+		return true;
+	}
+
+	int pack(const nspre::Subfile& subfile, const PackOptions& options, std::vector<char>& entry, uint32_t& version, bool& stored) {
+		int fd = open(subfile.path.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		if (fd < 0 || fstat(fd, &st) || st.st_size > UINT32_MAX) {
+			if (fd >= 0) {
+				close(fd);
+			}
+			return nspre::Error::FILE_OPEN;
+		}
+
+		stored = false;
+		if (options.auto_store && st.st_size) {
+			double entropy = sample_entropy(fd, st.st_size);
+			if (entropy < 0.0) {
+				close(fd);
+				return nspre::Error::FILE_OPEN;
+			}
+			stored = entropy / 8.0 >= options.store_ratio;
+		}
+		if (!stored) {
+			if (!nspre_entry(subfile.path, subfile.prepath, entry, version)) {
+				close(fd);
+				return -1;
+			}
+
+			// Nothing gained, storing it is just as small and faster to read
+			uint32_t cmp_size = get_u32(entry.data() + 4);
+			stored = cmp_size && cmp_size >= (uint64_t)st.st_size;
+			if (!stored) {
+				close(fd);
+				return 0;
+			}
+		}
+
+		// Only stored entries need the file's bytes here
+		PooledBuffer buffer(0);
+		std::vector<char>& data = buffer.data;
+		bool read = read_all(fd, data, st.st_size);
+		close(fd);
+		if (!read) {
+			return nspre::Error::FILE_OPEN;
+		}
+
+		if (empty_fd < 0) {
+			empty_fd = memfd_create("nspre-empty", MFD_CLOEXEC);
+		}
+		if (empty_fd < 0 || !nspre_entry("/proc/self/fd/" + std::to_string(empty_fd), subfile.prepath, entry, version)) {
+			return -1;
+		}
+
+		uint32_t name_len = get_u32(entry.data() + 8);
+		if (entry.size() < 16 + (uint64_t)name_len) {
+			return -1;
+		}
+
+		entry.resize(16 + name_len);
+		put_u32(entry.data(), data.size());
+		put_u32(entry.data() + 4, 0);
+		entry.insert(entry.end(), data.begin(), data.end());
+		entry.resize(entry.size() + ((4 - data.size() % 4) % 4));
+		return 0;
+	}
+
+	~EntryPacker() {
+		if (out_fd >= 0) {
+			close(out_fd);
+		}
+		if (empty_fd >= 0) {
+			close(empty_fd);
+		}
+	}
+};
+
+static int64_t mtime_ns(const struct stat& st) {
+	return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+static std::string cache_key(const nspre::Subfile& subfile) {
+	return subfile.path.string() + '\n' + subfile.prepath;
+}
+
+static bool copy_range(int from, uint64_t offset, int to, uint64_t length) {
+	loff_t in_off = offset;
+	while (length) {
+		ssize_t n = copy_file_range(from, &in_off, to, nullptr, length, 0);
+		if (n <= 0) {
+			break;
+		}
+		length -= n;
+	}
+
+	PooledBuffer buf(std::min<uint64_t>(length, 1 << 20));
+	while (length) {
+		ssize_t n = pread(from, buf.data.data(), std::min<uint64_t>(length, buf.data.size()), in_off);
+		if (n <= 0 || write(to, buf.data.data(), n) != n) {
+			return false;
+		}
+		in_off += n;
+		length -= n;
+	}
+
+	return true;
+}
+
+// One per thread, the memfds are kept for as long as the thread lives
+static EntryPacker& thread_packer() {
+	thread_local EntryPacker packer;
+	return packer;
+}
+
+// Same layout nspre::write produces, with entries packed in parallel a
+// window at a time and written in order. With a cache, entries whose source
+// has the size and mtime it had last time are copied from the previous
+// archive instead, and the cache is updated to point at this one.
+int write_pre(const std::vector<nspre::Subfile>& subfiles, const std::filesystem::path& path, const PackOptions& options, PackStats* stats, PackCache* cache) {
+	NS_PROFILE_SCOPE("write_pre");
+	int previous = -1;
+	if (cache && !cache->archive.empty() && cache->options.auto_store == options.auto_store && cache->options.store_ratio == options.store_ratio) {
+		previous = open(cache->archive.c_str(), O_RDONLY | O_CLOEXEC);
+		struct stat st;
+		if (previous >= 0 && (fstat(previous, &st) || (uint64_t)st.st_size != cache->archive_size || mtime_ns(st) != cache->archive_mtime_ns)) {
+			close(previous);
+			previous = -1;
+		}
+	}
+
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		if (previous >= 0) {
+			close(previous);
+		}
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	char header[12] = {};
+	bool ok = write(fd, header, sizeof(header)) == sizeof(header);
+	uint64_t offset = sizeof(header);
+	uint32_t version = previous >= 0 ? cache->version : 0;
+
+	size_t window = worker_pool.threads() * PACK_WINDOW;
+	std::vector<std::vector<char>> entries(window);
+	std::vector<uint32_t> versions(window);
+	std::vector<char> stored(window);
+	std::vector<PackCacheEntry> found(window);
+	std::vector<const PackCacheEntry*> reuse(window);
+	std::map<std::string,PackCacheEntry> packed;
+	int err = 0;
+
+	for (size_t first = 0; first < subfiles.size() && ok && !err; first += window) {
+		size_t count = std::min(window, subfiles.size() - first);
+
+		// Stat before packing, a source that changes in between is packed
+		// again next time rather than cached with its new mtime
+		for (size_t i = 0; i < count; ++i) {
+			reuse[i] = nullptr;
+			struct stat st;
+			if (cache && stat(subfiles[first + i].path.c_str(), &st) == 0) {
+				found[i].size = st.st_size;
+				found[i].mtime_ns = mtime_ns(st);
+				auto it = cache->entries.find(cache_key(subfiles[first + i]));
+				if (previous >= 0 && it != cache->entries.end() && it->second.size == found[i].size && it->second.mtime_ns == found[i].mtime_ns) {
+					reuse[i] = &it->second;
+				}
+			}
+		}
+
+		std::atomic<size_t> next{0};
+		std::atomic<int> failed{0};
+		worker_pool.run_parallel([&]() {
+			EntryPacker& packer = thread_packer();
+			for (size_t i; !failed && (i = next++) < count;) {
+				if (reuse[i]) {
+					continue;
+				}
+
+				bool s = false;
+				int e = packer.pack(subfiles[first + i], options, entries[i], versions[i], s);
+				stored[i] = s;
+				if (e) {
+					failed = e;
+				}
+			}
+		});
+
+		if ((err = failed)) {
+			break;
+		}
+
+		for (size_t i = 0; i < count && ok; ++i) {
+			PackCacheEntry e = found[i];
+			e.offset = offset;
+			if (reuse[i]) {
+				e.length = reuse[i]->length;
+				e.stored = reuse[i]->stored;
+				ok = copy_range(previous, reuse[i]->offset, fd, e.length);
+			}
+			else {
+				e.length = entries[i].size();
+				e.stored = stored[i];
+				version = versions[i];
+				ok = write(fd, entries[i].data(), entries[i].size()) == (ssize_t)entries[i].size();
+			}
+			offset += e.length;
+
+			if (stats) {
+				if (reuse[i]) {
+					++stats->reused;
+				}
+				else {
+					++(stored[i] ? stats->stored : stats->compressed);
+					stats->bytes_in += get_u32(entries[i].data());
+				}
+				stats->bytes_out += e.length;
+			}
+			if (cache) {
+				packed[cache_key(subfiles[first + i])] = e;
+			}
+		}
+	}
+
+	if (previous >= 0) {
+		close(previous);
+	}
+
+	if (!err && (!ok || offset > UINT32_MAX)) {
+		err = -1;
+	}
+	if (!err) {
+		put_u32(header, offset);
+		put_u32(header + 4, version);
+		put_u32(header + 8, subfiles.size());
+		if (pwrite(fd, header, sizeof(header), 0) != sizeof(header)) {
+			err = -1;
+		}
+	}
+
+	struct stat st;
+	if (!err && cache && fstat(fd, &st) == 0) {
+		cache->archive = path;
+		cache->archive_size = st.st_size;
+		cache->archive_mtime_ns = mtime_ns(st);
+		cache->version = version;
+		cache->options = options;
+		cache->entries = std::move(packed);
+	}
+	if (close(fd) && !err) {
+		err = -1;
+	}
+	if (err) {
+		unlink(path.c_str());
+	}
+
+	return err;
+}
+
+// Builds next to the archive and renames it over, so whatever is reading
+// the archive never sees it half written
+int rebuild_pre(const std::vector<nspre::Subfile>& subfiles, const std::filesystem::path& path, const PackOptions& options, PackCache& cache, PackStats* stats) {
+	fs::path tmp = path;
+	tmp += ".tmp";
+	int err = write_pre(subfiles, tmp, options, stats, &cache);
+	if (err) {
+		return err;
+	}
+
+	if (rename(tmp.c_str(), path.c_str())) {
+		unlink(tmp.c_str());
+		cache.archive.clear();
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	cache.archive = path;
+	return 0;
+}
+
+// Decodes entries of the archive being optimized. nspre::Reader isn't
+// shared between threads, so each one gets its own.
+struct EntryDecoder {
+	nspre::Reader reader;
+	std::unique_ptr<Extractor> extractor;
+	std::vector<char> data;
+	int fd = -1;
+
+	bool open(const fs::path& archive) {
+		fd = memfd_create("nspre-optimize", MFD_CLOEXEC);
+		if (fd < 0 || reader.open(archive)) {
+			return false;
+		}
+
+		extractor = std::make_unique<Extractor>(reader, archive);
+		return true;
+	}
+
+	// Leaves the decoded entry in the memfd for nspre::write to read
+	bool decode(size_t index) {
+		return extractor->read(index, data) && ftruncate(fd, 0) == 0 &&
+			pwrite(fd, data.data(), data.size(), 0) == (ssize_t)data.size();
+	}
+
+	~EntryDecoder() {
+		BufferPool::give(std::move(data));
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+};
+
+// Entries of an archive are stored back to back, so a window of them is one
+// range
+static void prefetch_window(int fd, const std::vector<PreLayoutEntry>& entries, size_t first, size_t last) {
+	if (first < last) {
+		const PreLayoutEntry& e = entries[last - 1];
+		posix_fadvise(fd, entries[first].header_offset, e.data_offset + e.data_size() - entries[first].header_offset, POSIX_FADV_WILLNEED);
+	}
+}
+
+// Recompresses every entry with nspre's encoder and keeps whichever of the
+// old and new entry is smaller, so the result is never bigger than the
+// input. Entries are decoded and packed in parallel a window at a time and
+// written in their original order.
+int optimize_pre(const std::filesystem::path& in, const std::filesystem::path& out, OptimizeStats& stats) {
+	NS_PROFILE_SCOPE("optimize_pre");
+	EstimatorPause pause;
+	auto start = std::chrono::steady_clock::now();
+	stats = OptimizeStats();
+
+	std::error_code ec;
+	if (fs::equivalent(in, out, ec)) {
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	PreLayout layout;
+	int in_fd = -1;
+	if (!layout.read(in) || (in_fd = open(in.c_str(), O_RDONLY | O_CLOEXEC)) < 0) {
+		return nspre::Error::FILE_OPEN;
+	}
+
+	int fd = open(out.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		close(in_fd);
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	// Every decoder holds a reader, charged at the archive's size like the
+	// readers of open tabs. At least one is made whatever the budget, pool
+	// threads that can't have one leave the window to those that do.
+	struct stat st;
+	uint64_t archive_size = fstat(in_fd, &st) == 0 && st.st_size > 0 ? st.st_size : 1;
+	size_t max_decoders = std::max<uint64_t>(1, std::min<uint64_t>(worker_pool.threads(), global.memory_budget / archive_size));
+	size_t made = 0;
+	std::mutex mutex;
+	std::vector<std::unique_ptr<EntryDecoder>> decoders;
+
+	char header[12] = {};
+	bool ok = write(fd, header, sizeof(header)) == sizeof(header);
+	uint64_t offset = sizeof(header);
+
+	const std::vector<PreLayoutEntry>& old_entries = layout.entries();
+	size_t window = worker_pool.threads() * PACK_WINDOW;
+	std::vector<std::vector<char>> entries(window);
+	std::vector<char> keep(window);
+	int err = 0;
+
+	posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	for (size_t first = 0; first < old_entries.size() && ok && !err; first += window) {
+		size_t count = std::min(window, old_entries.size() - first);
+
+		// The decoders read through nspre, the hint gets the next window
+		// into the page cache while this one is packed
+		if (first == 0) {
+			prefetch_window(in_fd, old_entries, 0, count);
+		}
+		prefetch_window(in_fd, old_entries, first + count, std::min(first + count + window, old_entries.size()));
+		std::atomic<size_t> next{0};
+		std::atomic<int> failed{0};
+		worker_pool.run_parallel([&]() {
+			std::unique_ptr<EntryDecoder> decoder;
+			{
+				std::lock_guard<std::mutex> guard(mutex);
+				if (decoders.size()) {
+					decoder = std::move(decoders.back());
+					decoders.pop_back();
+				}
+				else if (made == max_decoders) {
+					return;
+				}
+				else {
+					++made;
+				}
+			}
+			if (!decoder) {
+				decoder = std::make_unique<EntryDecoder>();
+				if (!decoder->open(in)) {
+					failed = nspre::Error::FILE_OPEN;
+					return;
+				}
+			}
+
+			EntryPacker& packer = thread_packer();
+			for (size_t i; !failed && (i = next++) < count;) {
+				const PreLayoutEntry& e = old_entries[first + i];
+				uint64_t old_length = e.data_offset - e.header_offset + ((e.data_size() + 3) & ~(uint64_t)3);
+				PackOptions options;
+				uint32_t version;
+				bool stored;
+				if (!decoder->decode(first + i)) {
+					failed = nspre::Error::FILE_OPEN;
+					break;
+				}
+
+				nspre::Subfile subfile = {"/proc/self/fd/" + std::to_string(decoder->fd), e.prepath};
+				if (packer.pack(subfile, options, entries[i], version, stored)) {
+					failed = -1;
+					break;
+				}
+				keep[i] = entries[i].size() < old_length;
+			}
+
+			std::lock_guard<std::mutex> guard(mutex);
+			decoders.push_back(std::move(decoder));
+		});
+
+		if ((err = failed)) {
+			break;
+		}
+
+		for (size_t i = 0; i < count && ok; ++i) {
+			const PreLayoutEntry& e = old_entries[first + i];
+			uint64_t old_length = e.data_offset - e.header_offset + ((e.data_size() + 3) & ~(uint64_t)3);
+			if (keep[i]) {
+				ok = write(fd, entries[i].data(), entries[i].size()) == (ssize_t)entries[i].size();
+				offset += entries[i].size();
+				++stats.improved;
+			}
+			else {
+				ok = copy_range(in_fd, e.header_offset, fd, old_length);
+				offset += old_length;
+			}
+		}
+	}
+
+	close(in_fd);
+	if (!err && (!ok || offset > UINT32_MAX)) {
+		err = -1;
+	}
+	if (!err) {
+		put_u32(header, offset);
+		put_u32(header + 4, layout.version());
+		put_u32(header + 8, old_entries.size());
+		if (pwrite(fd, header, sizeof(header), 0) != sizeof(header)) {
+			err = -1;
+		}
+	}
+	if (close(fd) && !err) {
+		err = -1;
+	}
+	if (err) {
+		unlink(out.c_str());
+		return err;
+	}
+
+	stats.entries = old_entries.size();
+	stats.bytes_before = layout.file_size();
+	stats.bytes_after = offset;
+	stats.ms = std::chrono::duration<float,std::milli>(std::chrono::steady_clock::now() - start).count();
+	return 0;
+}
+
+}
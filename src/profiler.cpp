@@ -0,0 +1,204 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace ns {
+
+Profiler profiler;
+
+// Small per-thread ids read better in the trace viewer than hashed thread ids
+static std::atomic<int> next_tid(1);
+static thread_local int trace_tid = 0;
+
+uint64_t Profiler::now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Profiler::start_trace(const std::filesystem::path& path) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_trace = std::fopen(path.c_str(), "w");
+	if (!m_trace) {
+		return false;
+	}
+
+	std::fprintf(m_trace, "{\"traceEvents\":[\n");
+	m_first_event = true;
+	m_enabled = true;
+	return true;
+}
+
+void Profiler::end_trace() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_trace) {
+		return;
+	}
+
+	std::fprintf(m_trace, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	std::fclose(m_trace);
+	m_trace = 0;
+	m_enabled = m_overlay;
+}
+
+void Profiler::set_overlay(bool show) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_overlay = show;
+	m_enabled = m_overlay || m_trace;
+}
+
+void Profiler::record(const char* name, uint64_t start_ns, uint64_t end_ns) {
+	if (!trace_tid) {
+		trace_tid = next_tid++;
+	}
+
+	float ms = (end_ns - start_ns) / 1000000.0f;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_trace) {
+		std::fprintf(m_trace, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+			m_first_event ? "" : ",\n",
+			name,
+			(start_ns - m_epoch) / 1000.0,
+			(end_ns - start_ns) / 1000.0,
+			trace_tid
+		);
+		m_first_event = false;
+	}
+
+	// Scope names are string literals, so the pointer identifies the scope
+	int i = 0;
+	while (i < m_stat_count && m_stats[i].name != name) {
+		++i;
+	}
+
+	if (i == m_stat_count) {
+		if (m_stat_count == PROFILER_MAX_SCOPES) {
+			return;
+		}
+
+		m_stats[i].name = name;
+		++m_stat_count;
+	}
+
+	ProfileStat& st = m_stats[i];
+	st.last_ms = ms;
+	st.avg_ms = st.count ? st.avg_ms * 0.95f + ms * 0.05f : ms;
+	st.max_ms = std::max(st.max_ms, ms);
+	++st.count;
+}
+
+void Profiler::frame(uint64_t start_ns, uint64_t end_ns) {
+	record("frame", start_ns, end_ns);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_frame_ms[m_frame_pos] = (end_ns - start_ns) / 1000000.0f;
+	m_frame_pos = (m_frame_pos + 1) % PROFILER_FRAMES;
+	if (m_frame_count < PROFILER_FRAMES) {
+		++m_frame_count;
+	}
+}
+
+void Profiler::show(bool* open) {
+	set_overlay(*open);
+	if (!*open) {
+		return;
+	}
+
+	float frames[PROFILER_FRAMES];
+	float sorted[PROFILER_FRAMES];
+	ProfileStat stats[PROFILER_MAX_SCOPES];
+	int frame_count;
+	int frame_pos;
+	int stat_count;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::copy(m_frame_ms, m_frame_ms + PROFILER_FRAMES, frames);
+		std::copy(m_stats, m_stats + m_stat_count, stats);
+		frame_count = m_frame_count;
+		frame_pos = m_frame_pos;
+		stat_count = m_stat_count;
+	}
+
+	ImGui::SetNextWindowPos({24, 48}, ImGuiCond_FirstUseEver);
+	if (!ImGui::Begin("Profiler", open, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings)) {
+		ImGui::End();
+		return;
+	}
+
+	if (frame_count) {
+		std::copy(frames, frames + frame_count, sorted);
+		std::sort(sorted, sorted + frame_count);
+		auto pct = [&](float p) { return sorted[std::min(frame_count - 1, (int)(p * frame_count))]; };
+
+		ImGui::Text("Frame time over last %d frames", frame_count);
+		ImGui::Text("p50 %.2f ms  p90 %.2f ms  p99 %.2f ms  max %.2f ms", pct(0.5f), pct(0.9f), pct(0.99f), sorted[frame_count - 1]);
+
+		int offset = frame_count < PROFILER_FRAMES ? 0 : frame_pos;
+		ImGui::PlotLines("###frametimes", frames, frame_count, offset, 0, 0.0f, pct(0.99f) * 1.25f, {360, 60});
+	}
+	else {
+		ImGui::Text("No frames recorded yet");
+	}
+
+	if (stat_count && ImGui::BeginTable("profiler_scopes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("Last (ms)");
+		ImGui::TableSetupColumn("Avg (ms)");
+		ImGui::TableSetupColumn("Max (ms)");
+		ImGui::TableSetupColumn("Count");
+		ImGui::TableHeadersRow();
+
+		for (int i = 0; i < stat_count; ++i) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%s", stats[i].name);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats[i].last_ms);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats[i].avg_ms);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.3f", stats[i].max_ms);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", (unsigned long long)stats[i].count);
+		}
+
+		ImGui::EndTable();
+	}
+
+	BufferPoolStats pool = BufferPool::stats();
+	if (pool.takes) {
+		ImGui::Text("Buffer pool: %llu takes, %.1f%% reused", (unsigned long long)pool.takes, 100.0 * pool.reuses / pool.takes);
+		ImGui::Text("In use %.1f MiB (peak %.1f)  cached %.1f MiB (peak %.1f)",
+			pool.in_use / 1048576.0, pool.peak_in_use / 1048576.0, pool.cached / 1048576.0, pool.peak_cached / 1048576.0);
+	}
+
+	ImGui::End();
+}
+
+Profiler::Profiler() : m_epoch(now_ns()) {}
+
+Profiler::~Profiler() {
+	end_trace();
+}
+
+}
@@ -0,0 +1,287 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace ns {
+
+static const uint64_t SAMPLE_SIZE = 64 << 10;
+static const unsigned MAX_SAMPLES = 8;
+
+// Files up to this size are compressed whole on the first pass
+static const uint64_t EXACT_SIZE = 256 << 10;
+
+// Spreads samples over the file, each pass landing between the earlier ones
+static double sample_position(unsigned sample) {
+	double position = 0.0;
+	double step = 0.5;
+	for (; sample; sample >>= 1, step /= 2) {
+		if (sample & 1) {
+			position += step;
+		}
+	}
+
+	return position;
+}
+
+// nspre only takes paths, so the sample and the archive it compresses into
+// are both memfds. The compressed size is read back from the entry header.
+struct SampleEncoder {
+	int in_fd = -1;
+	int out_fd = -1;
+	std::vector<char> buffer;
+
+	bool encode(int src_fd, uint64_t offset, uint64_t size, uint64_t& compressed) {
+		if (in_fd < 0) {
+			in_fd = memfd_create("nspre-sample", MFD_CLOEXEC);
+			out_fd = memfd_create("nspre-sample-pre", MFD_CLOEXEC);
+		}
+		if (in_fd < 0 || out_fd < 0 || ftruncate(in_fd, 0) || ftruncate(out_fd, 0)) {
+			return false;
+		}
+
+		buffer.resize(size);
+		uint64_t done = 0;
+		while (done < size) {
+			ssize_t n = pread(src_fd, buffer.data() + done, size - done, offset + done);
+			if (n <= 0) {
+				return false;
+			}
+			done += n;
+		}
+		if (pwrite(in_fd, buffer.data(), size, 0) != (ssize_t)size) {
+			return false;
+		}
+
+		std::vector<nspre::Subfile> subfiles;
+		subfiles.push_back({"/proc/self/fd/" + std::to_string(in_fd), "s"});
+		if (nspre::write(subfiles, "/proc/self/fd/" + std::to_string(out_fd))) {
+			return false;
+		}
+
+		unsigned char header[20];
+		if (pread(out_fd, header, sizeof(header), 0) != sizeof(header)) {
+			return false;
+		}
+
+		uint32_t cmp_size = (uint32_t)header[16] | ((uint32_t)header[17] << 8) | ((uint32_t)header[18] << 16) | ((uint32_t)header[19] << 24);
+		compressed = cmp_size ? cmp_size : size;
+		return true;
+	}
+
+	~SampleEncoder() {
+		if (in_fd >= 0) {
+			close(in_fd);
+		}
+		if (out_fd >= 0) {
+			close(out_fd);
+		}
+	}
+};
+
+// One per thread, the memfds are kept for as long as the thread lives
+static SampleEncoder& thread_encoder() {
+	thread_local SampleEncoder encoder;
+	return encoder;
+}
+
+// Jobs that came up during a pause, submitted again once it ends
+static std::mutex s_pause_mutex;
+static unsigned s_pauses = 0;
+static std::vector<std::function<void()>> s_parked;
+
+EstimatorPause::EstimatorPause() {
+	std::lock_guard<std::mutex> guard(s_pause_mutex);
+	++s_pauses;
+}
+
+EstimatorPause::~EstimatorPause() {
+	std::vector<std::function<void()>> parked;
+	{
+		std::lock_guard<std::mutex> guard(s_pause_mutex);
+		if (--s_pauses == 0) {
+			parked.swap(s_parked);
+		}
+	}
+
+	for (auto& job : parked) {
+		worker_pool.submit(std::move(job));
+	}
+}
+
+// Takes one sample and puts the input back at the end of the queue if it
+// could use another. The job then submits itself again rather than looping,
+// so opens, scans and saves queued on the pool meanwhile go first.
+void SizeEstimator::run(std::shared_ptr<State> state, unsigned generation) {
+	NS_PROFILE_SCOPE("estimate_sizes");
+	{
+		std::lock_guard<std::mutex> guard(s_pause_mutex);
+		if (s_pauses) {
+			s_parked.push_back([state, generation]() { run(state, generation); });
+			return;
+		}
+	}
+
+	Input input;
+	{
+		std::lock_guard<std::mutex> guard(state->mutex);
+		if (generation != state->generation) {
+			return;
+		}
+		if (state->queue.empty()) {
+			--state->running;
+			return;
+		}
+
+		input = std::move(state->queue.front());
+		state->queue.pop_front();
+	}
+
+	auto next = [state, generation]() {
+		worker_pool.submit([state, generation]() { run(state, generation); });
+	};
+
+	// An input that can't be read gets a final estimate of its size as is,
+	// so its row and the sampled count still settle
+	auto give_up = [&state, generation, &input]() {
+		SizeEstimate& e = input.estimate;
+		e.sampled = 0;
+		e.compressed = 0;
+		e.exact = true;
+		{
+			std::lock_guard<std::mutex> guard(state->mutex);
+			if (generation != state->generation) {
+				return;
+			}
+			state->updates.push_back({input.id, e});
+		}
+		request_redraw();
+	};
+
+	SizeEstimate& e = input.estimate;
+	int fd = open(input.path.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st)) {
+		if (fd >= 0) {
+			close(fd);
+		}
+		give_up();
+		next();
+		return;
+	}
+	e.size = st.st_size;
+
+	uint64_t offset = 0;
+	uint64_t size = e.size;
+	if (e.size > EXACT_SIZE) {
+		size = SAMPLE_SIZE;
+		offset = (uint64_t)(sample_position(input.samples) * (e.size - SAMPLE_SIZE)) & ~(uint64_t)3;
+	}
+
+	uint64_t compressed = 0;
+	bool ok = size == 0 || thread_encoder().encode(fd, offset, size, compressed);
+	close(fd);
+	if (!ok) {
+		give_up();
+		next();
+		return;
+	}
+
+	e.sampled += size;
+	e.compressed += compressed;
+	e.exact = size == e.size;
+	++input.samples;
+
+	{
+		std::lock_guard<std::mutex> guard(state->mutex);
+		if (generation != state->generation) {
+			return;
+		}
+
+		state->updates.push_back({input.id, e});
+		if (!e.exact && input.samples < MAX_SAMPLES) {
+			state->queue.push_back(std::move(input));
+		}
+	}
+	request_redraw();
+	next();
+}
+
+// Leaves a core for the render thread and whatever else the pool is doing
+void SizeEstimator::add(uint32_t id, const std::filesystem::path& path) {
+	std::lock_guard<std::mutex> guard(m_state->mutex);
+	Input input;
+	input.id = id;
+	input.path = path;
+	m_state->queue.push_back(std::move(input));
+
+	unsigned jobs = std::max(1u, worker_pool.threads() - 1);
+	std::shared_ptr<State> state = m_state;
+	unsigned generation = m_state->generation;
+	for (; m_state->running < jobs; ++m_state->running) {
+		worker_pool.submit([state, generation]() { run(state, generation); });
+	}
+}
+
+// Drops queued inputs of rows that left the list. ids must be sorted.
+void SizeEstimator::remove(const std::vector<uint32_t>& ids) {
+	std::lock_guard<std::mutex> guard(m_state->mutex);
+	auto removed = [&ids](const Input& input) {
+		return std::binary_search(ids.begin(), ids.end(), input.id);
+	};
+	auto& queue = m_state->queue;
+	queue.erase(std::remove_if(queue.begin(), queue.end(), removed), queue.end());
+}
+
+void SizeEstimator::cancel() {
+	std::lock_guard<std::mutex> guard(m_state->mutex);
+	++m_state->generation;
+	m_state->queue.clear();
+	m_state->updates.clear();
+	m_state->running = 0;
+}
+
+bool SizeEstimator::busy() {
+	std::lock_guard<std::mutex> guard(m_state->mutex);
+	return m_state->running > 0;
+}
+
+void SizeEstimator::poll(std::vector<std::pair<uint32_t,SizeEstimate>>& out) {
+	std::lock_guard<std::mutex> guard(m_state->mutex);
+	out.swap(m_state->updates);
+	m_state->updates.clear();
+}
+
+SizeEstimator::SizeEstimator() : m_state(std::make_shared<State>()) {
+
+}
+
+SizeEstimator::~SizeEstimator() {
+	cancel();
+}
+
+}
@@ -0,0 +1,262 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace ns {
+
+static const size_t TAR_BLOCK = 512;
+static const size_t TAR_RECORD = TAR_BLOCK * 20;
+
+std::string tar_path(const std::string& prepath) {
+	std::string path(prepath);
+	for (char& c : path) {
+		if (c == '\\') {
+			c = '/';
+		}
+	}
+
+	size_t start = path.find_first_not_of('/');
+	return start == std::string::npos ? std::string() : path.substr(start);
+}
+
+namespace {
+
+struct TarHeader {
+	char block[TAR_BLOCK];
+
+	void octal(size_t offset, size_t width, uint64_t v) {
+		std::snprintf(block + offset, width, "%0*llo", (int)width - 1, (unsigned long long)v);
+	}
+
+	void field(size_t offset, size_t width, const std::string& s) {
+		std::memcpy(block + offset, s.data(), s.size() < width ? s.size() : width);
+	}
+
+	// ustar, with the path split over prefix and name where it doesn't fit
+	// in name alone. Returns false if it can't be split.
+	bool set(const std::string& path, uint64_t size, int64_t mtime, char type) {
+		std::memset(block, 0, sizeof(block));
+		bool fits = true;
+		if (path.size() <= 100) {
+			field(0, 100, path);
+		}
+		else {
+			size_t split = path.rfind('/', 155);
+			fits = split != std::string::npos && split != 0 && path.size() - split - 1 <= 100 && path.size() - split - 1 > 0;
+			if (fits) {
+				field(345, 155, path.substr(0, split));
+				field(0, 100, path.substr(split + 1));
+			}
+			else {
+				field(0, 100, path);
+			}
+		}
+
+		octal(100, 8, 0644);
+		octal(108, 8, 0);
+		octal(116, 8, 0);
+		octal(124, 12, size);
+		octal(136, 12, mtime > 0 ? mtime : 0);
+		block[156] = type;
+		std::memcpy(block + 257, "ustar", 6);
+		std::memcpy(block + 263, "00", 2);
+
+		std::memset(block + 148, ' ', 8);
+		unsigned sum = 0;
+		for (unsigned char c : block) {
+			sum += c;
+		}
+		std::snprintf(block + 148, 8, "%06o", sum);
+		return fits;
+	}
+};
+
+// Double buffering between the thread decoding entries and the one writing
+// the stream
+struct TarSlot {
+	std::vector<char> data;
+	uint32_t index = 0;
+	bool full = false;
+	bool ok = false;
+
+	~TarSlot() { BufferPool::give(std::move(data)); }
+};
+
+class TarStream {
+	int m_fd;
+	uint64_t m_written = 0;
+	bool m_failed = false;
+public:
+	TarStream(int fd) : m_fd(fd) {}
+
+	bool write(const char* a, size_t a_size, const char* b = 0, size_t b_size = 0) {
+		static const char zeros[TAR_BLOCK] = {};
+		size_t pad = (TAR_BLOCK - (a_size + b_size) % TAR_BLOCK) % TAR_BLOCK;
+		struct iovec iov[3] = {{(void*)a, a_size}, {(void*)b, b_size}, {(void*)zeros, pad}};
+		int count = 3;
+		struct iovec* v = iov;
+		while (!m_failed && count) {
+			ssize_t n = writev(m_fd, v, count);
+			if (n < 0) {
+				m_failed = true;
+				break;
+			}
+
+			m_written += n;
+			while (count && (size_t)n >= v->iov_len) {
+				n -= v->iov_len;
+				++v;
+				--count;
+			}
+			if (count) {
+				v->iov_base = (char*)v->iov_base + n;
+				v->iov_len -= n;
+			}
+		}
+
+		return !m_failed;
+	}
+
+	bool entry(const std::string& path, const std::vector<char>& data, int64_t mtime) {
+		TarHeader h;
+		if (!h.set(path, data.size(), mtime, '0')) {
+			// Too long for ustar, the full path goes in a pax header first
+			std::string record = " path=" + path + "\n";
+			size_t len = record.size();
+			size_t digits = std::to_string(len).size();
+			while (std::to_string(len + digits).size() != digits) {
+				++digits;
+			}
+			record = std::to_string(len + digits) + record;
+
+			TarHeader pax;
+			pax.set("PaxHeaders/" + path.substr(path.size() > 80 ? path.size() - 80 : 0), record.size(), mtime, 'x');
+			if (!write(pax.block, TAR_BLOCK) || !write(record.data(), record.size())) {
+				return false;
+			}
+		}
+
+		return write(h.block, TAR_BLOCK, data.data(), data.size());
+	}
+
+	// Two zero blocks, then padding out to a whole record
+	bool end() {
+		static const char zeros[TAR_RECORD] = {};
+		size_t size = 2 * TAR_BLOCK;
+		size += (TAR_RECORD - (m_written + size) % TAR_RECORD) % TAR_RECORD;
+		return write(zeros, size);
+	}
+};
+
+}
+
+// Streams the given entries, or all of them if subset is null, as a POSIX
+// tar file. A path of "-" writes to stdout. Entries are written in the order
+// their data appears in the archive, decoded on a second thread into one
+// buffer while the other is written. Returns 0,
+// FILE_OPEN_OUTPUT, FILE_OPEN with failed set to the entry that couldn't be
+// read, or -1 if the output couldn't be written.
+int write_tar(nspre::Reader& reader, const std::filesystem::path& archive, const std::filesystem::path& path, const std::vector<uint32_t>* subset, std::string* failed) {
+	int fd = (path == "-") ? dup(STDOUT_FILENO) : open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return nspre::Error::FILE_OPEN_OUTPUT;
+	}
+
+	struct stat st;
+	int64_t mtime = stat(archive.c_str(), &st) == 0 ? st.st_mtim.tv_sec : 0;
+
+	Extractor extractor(reader, archive);
+	extractor.use_prefetch(worker_pool.threads() * PREFETCH_PER_WORKER);
+	std::vector<uint32_t> order = extractor.offset_order(subset);
+	TarSlot slots[2];
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool abort = false;
+
+	std::thread decoder([&]() {
+		for (size_t k = 0; k < order.size(); ++k) {
+			TarSlot& slot = slots[k % 2];
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [&]() { return !slot.full || abort; });
+				if (abort) {
+					return;
+				}
+			}
+
+			slot.index = order[k];
+			extractor.prefetch(order, k);
+			slot.ok = extractor.read(slot.index, slot.data);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			slot.full = true;
+			cv.notify_all();
+		}
+	});
+
+	TarStream out(fd);
+	int err = 0;
+	for (size_t k = 0; k < order.size() && !err; ++k) {
+		TarSlot& slot = slots[k % 2];
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&]() { return slot.full; });
+		}
+
+		auto& file = reader.files()[slot.index];
+		if (!slot.ok) {
+			err = nspre::Error::FILE_OPEN;
+			if (failed) {
+				*failed = file.prepath();
+			}
+		}
+		else if (!out.entry(tar_path(file.prepath()), slot.data, mtime)) {
+			err = -1;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.full = false;
+		cv.notify_all();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		abort = true;
+		cv.notify_all();
+	}
+	decoder.join();
+
+	if (!err && !out.end()) {
+		err = -1;
+	}
+	if (close(fd) && !err) {
+		err = -1;
+	}
+
+	return err;
+}
+
+}
@@ -0,0 +1,304 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ns {
+
+// Set in user_data to tell the completions of one file apart
+static const uint64_t URING_WRITE = 1ull << 32;
+static const uint64_t URING_CLOSE = 2ull << 32;
+
+// The rings are driven with raw syscalls so there's no liburing dependency
+struct UringWriter::Ring {
+	int fd = -1;
+	void* sq_ptr = MAP_FAILED;
+	void* cq_ptr = MAP_FAILED;
+	size_t sq_len = 0;
+	size_t cq_len = 0;
+	io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED;
+	size_t sqes_len = 0;
+	unsigned* sq_head;
+	unsigned* sq_tail;
+	unsigned* sq_array;
+	unsigned sq_mask;
+	unsigned sq_entries;
+	unsigned* cq_head;
+	unsigned* cq_tail;
+	unsigned cq_mask;
+	io_uring_cqe* cqes;
+	unsigned tail = 0;
+
+	bool setup(unsigned depth) {
+		io_uring_params p;
+		std::memset(&p, 0, sizeof(p));
+		fd = syscall(__NR_io_uring_setup, depth, &p);
+		if (fd < 0) {
+			return false;
+		}
+
+		sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+		if (single) {
+			sq_len = cq_len = std::max(sq_len, cq_len);
+		}
+
+		sq_ptr = mmap(0, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+		if (sq_ptr == MAP_FAILED) {
+			return false;
+		}
+		cq_ptr = single ? sq_ptr : mmap(0, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED) {
+			return false;
+		}
+		sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+		sqes = (io_uring_sqe*)mmap(0, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED) {
+			return false;
+		}
+
+		char* sq = (char*)sq_ptr;
+		char* cq = (char*)cq_ptr;
+		sq_head = (unsigned*)(sq + p.sq_off.head);
+		sq_tail = (unsigned*)(sq + p.sq_off.tail);
+		sq_mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+		sq_entries = p.sq_entries;
+		sq_array = (unsigned*)(sq + p.sq_off.array);
+		cq_head = (unsigned*)(cq + p.cq_off.head);
+		cq_tail = (unsigned*)(cq + p.cq_off.tail);
+		cq_mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+		cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+		tail = *sq_tail;
+		return supports({IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE});
+	}
+
+	bool supports(std::initializer_list<int> ops) {
+		size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+		std::vector<char> buf(size, 0);
+		io_uring_probe* probe = (io_uring_probe*)buf.data();
+		if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+			return false;
+		}
+
+		for (int op : ops) {
+			if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	io_uring_sqe* next() {
+		unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+		if (tail - head >= sq_entries) {
+			return nullptr;
+		}
+
+		unsigned index = tail & sq_mask;
+		sq_array[index] = index;
+		++tail;
+		io_uring_sqe* sqe = &sqes[index];
+		std::memset(sqe, 0, sizeof(*sqe));
+		return sqe;
+	}
+
+	~Ring() {
+		if (sqes != MAP_FAILED) munmap(sqes, sqes_len);
+		if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_len);
+		if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_len);
+		if (fd >= 0) close(fd);
+	}
+};
+
+UringWriter::UringWriter() {}
+
+UringWriter::~UringWriter() {
+	flush();
+}
+
+// Each file takes two entries in the second submission, so a batch is half
+// the queue depth
+bool UringWriter::init(unsigned depth) {
+	if (depth < 2) {
+		return false;
+	}
+
+	auto ring = std::make_unique<Ring>();
+	if (!ring->setup(depth)) {
+		return false;
+	}
+
+	m_batch = ring->sq_entries / 2;
+	m_ring = std::move(ring);
+	m_pending.reserve(m_batch);
+	return true;
+}
+
+// Submits everything queued and reaps count completions into m_pending
+int UringWriter::submit_and_wait(unsigned count) {
+	Ring& r = *m_ring;
+	__atomic_store_n(r.sq_tail, r.tail, __ATOMIC_RELEASE);
+
+	unsigned submitted = 0;
+	unsigned reaped = 0;
+	while (reaped < count) {
+		int n = syscall(__NR_io_uring_enter, r.fd, count - submitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -errno;
+		}
+		submitted += n;
+
+		unsigned head = *r.cq_head;
+		unsigned tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; ++head, ++reaped) {
+			io_uring_cqe& cqe = r.cqes[head & r.cq_mask];
+			Pending& p = m_pending[cqe.user_data & 0xffffffff];
+			uint64_t kind = cqe.user_data & ~0xffffffffull;
+			if (kind == URING_WRITE) {
+				p.written = cqe.res;
+			}
+			else if (kind == URING_CLOSE) {
+				p.closed = cqe.res >= 0;
+			}
+			else if (cqe.res >= 0) {
+				p.fd = cqe.res;
+			}
+			else {
+				p.error = cqe.res;
+			}
+		}
+		__atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+int UringWriter::flush() {
+	if (m_pending.empty() || !m_ring) {
+		return 0;
+	}
+
+	int err = 0;
+	for (size_t i = 0; i < m_pending.size(); ++i) {
+		io_uring_sqe* sqe = m_ring->next();
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (uint64_t)m_pending[i].path.c_str();
+		sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+		sqe->len = 0644;
+		sqe->user_data = i;
+	}
+
+	unsigned count = 0;
+	if (submit_and_wait(m_pending.size()) == 0) {
+		for (size_t i = 0; i < m_pending.size(); ++i) {
+			Pending& p = m_pending[i];
+			if (p.fd < 0) {
+				continue;
+			}
+
+			// A failed or short write cancels the linked close
+			io_uring_sqe* sqe = m_ring->next();
+			sqe->opcode = IORING_OP_WRITE;
+			sqe->fd = p.fd;
+			sqe->addr = (uint64_t)p.data.data();
+			sqe->len = p.data.size();
+			sqe->off = 0;
+			sqe->flags = IOSQE_IO_LINK;
+			sqe->user_data = i | URING_WRITE;
+
+			sqe = m_ring->next();
+			sqe->opcode = IORING_OP_CLOSE;
+			sqe->fd = p.fd;
+			sqe->user_data = i | URING_CLOSE;
+			count += 2;
+		}
+
+		if (count) {
+			submit_and_wait(count);
+		}
+	}
+
+	for (auto& p : m_pending) {
+		bool ok = p.fd >= 0 && p.written == (int64_t)p.data.size() && p.closed;
+		if (p.fd >= 0 && !p.closed) {
+			// The close was cancelled, so the fd is still ours
+			size_t done = p.written > 0 ? p.written : 0;
+			while (done < p.data.size()) {
+				ssize_t n = pwrite(p.fd, p.data.data() + done, p.data.size() - done, done);
+				if (n <= 0) {
+					break;
+				}
+				done += n;
+			}
+			bool written = done == p.data.size();
+			ok = (close(p.fd) == 0) && written;
+		}
+
+		if (!ok && !err) {
+			err = p.fd < 0 ? nspre::Error::FILE_OPEN_OUTPUT : -1;
+			m_failed = p.path;
+		}
+		BufferPool::give(std::move(p.data));
+	}
+
+	m_pending.clear();
+	return err;
+}
+
+int UringWriter::add(const std::filesystem::path& path, std::vector<char>&& data) {
+	// Opens in a batch all truncate and the writes land in any order, a path
+	// that is already queued has to be written out first so the last entry
+	// wins
+	for (auto& queued : m_pending) {
+		if (queued.path == path) {
+			int err = flush();
+			if (err) {
+				return err;
+			}
+			break;
+		}
+	}
+
+	Pending p;
+	p.path = path;
+	p.data = std::move(data);
+	m_pending.push_back(std::move(p));
+	if (m_pending.size() >= m_batch) {
+		return flush();
+	}
+
+	return 0;
+}
+
+}
@@ -0,0 +1,137 @@
+// Copyright (c) 2025 Bryan Rykowski
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "nspre-gui.hpp"
+
+// Number of pool threads, 0 uses one per hardware thread
+#ifndef NSPRE_GUI_WORKERS
+#define NSPRE_GUI_WORKERS 0
+#endif
+
+namespace ns {
+
+WorkerPool worker_pool;
+
+void WorkerPool::run() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_cv.wait(lock, [this]() { return m_quit || m_jobs.size(); });
+		if (m_quit) {
+			return;
+		}
+
+		std::function<void()> job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		lock.unlock();
+		job();
+		lock.lock();
+	}
+}
+
+unsigned WorkerPool::threads() {
+	unsigned n = NSPRE_GUI_WORKERS;
+	if (n == 0) {
+		n = std::thread::hardware_concurrency();
+	}
+
+	return n < 2 ? 2 : n;
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_quit) {
+			return;
+		}
+
+		m_jobs.push_back(std::move(job));
+		if (m_workers.empty()) {
+			for (unsigned i = threads(); i > 0; --i) {
+				m_workers.emplace_back(&WorkerPool::run, this);
+			}
+		}
+	}
+
+	m_cv.notify_one();
+}
+
+// Runs work on the calling thread and on as many pool threads as are free,
+// and returns once every copy that started has returned. work is expected to
+// pull items off a shared counter until there are none left. Safe to call
+// from a pool job, helpers that only start after the caller is done do
+// nothing.
+void WorkerPool::run_parallel(const std::function<void()>& work) {
+	struct Shared {
+		std::mutex mutex;
+		std::condition_variable cv;
+		unsigned active = 0;
+		bool closed = false;
+	};
+
+	auto shared = std::make_shared<Shared>();
+	const std::function<void()>* fn = &work;
+	for (unsigned i = 1; i < threads(); ++i) {
+		submit([shared, fn]() {
+			{
+				std::lock_guard<std::mutex> lock(shared->mutex);
+				if (shared->closed) {
+					return;
+				}
+				++shared->active;
+			}
+
+			(*fn)();
+
+			std::lock_guard<std::mutex> lock(shared->mutex);
+			--shared->active;
+			shared->cv.notify_all();
+		});
+	}
+
+	work();
+
+	std::unique_lock<std::mutex> lock(shared->mutex);
+	shared->cv.wait(lock, [&shared]() { return shared->active == 0; });
+	shared->closed = true;
+}
+
+// Queued jobs are dropped, running ones are waited for
+void WorkerPool::shutdown() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+		m_jobs.clear();
+	}
+
+	m_cv.notify_all();
+	for (auto& t : m_workers) {
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+
+	m_workers.clear();
+}
+
+WorkerPool::~WorkerPool() {
+	shutdown();
+}
+
+}